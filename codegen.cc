@@ -16,652 +16,4110 @@
 
 #include "codegen.h"
 
+#include <algorithm>
+#include <map>
 #include <set>
 
 using enum_id = std::size_t;
 
+// the error entry of the action table.
+const std::size_t no_action = static_cast<std::size_t>(-1);
+
+// the transitions that leave a scanner; the states are numbered from 2.
+const std::size_t scanner_error = 0;
+const std::size_t scanner_done = 1;
+const std::size_t scanner_first_state = 2;
+
 class ostream_with_newlines {
   std::ostream* os;
 
- public:
-  explicit ostream_with_newlines(std::ostream* os_) : os(os_) {
+ public:
+  explicit ostream_with_newlines(std::ostream* os_) : os(os_) {
+    return;
+  }
+
+  template <typename T>
+  ostream_with_newlines& operator<<(T&& s) {
+    (*os) << std::forward<T>(s) << std::endl;
+    return *this;
+  }
+};
+
+class code_generator {
+  ostream_with_newlines header;
+  ostream_with_newlines ccfile;
+  token_id first_nonterm;
+  token_id last_term;
+  token_id atmark;
+  token_id special_token;
+  token_id spaces;
+  const token_set_type& terminate_symbols;
+  const token_set_type& non_terminate_symbols;
+  const classes_type& classes;
+  const literals_type& literals;
+  const repeats_type& repeats;
+  const token_set_type& lexemes;
+  const id_to_token_type& id_to_token;
+  const token_to_id_type& token_to_id;
+  const rules_type& rules;
+  const table_type& table;
+  const codegen_options& options;
+
+  std::unordered_map<token_id, std::string> token_id_to_enum_string;
+  std::unordered_map<token_id, enum_id> token_id_to_enum_id;
+  std::unordered_map<enum_id, token_id> enum_id_to_token_id;
+  std::unordered_map<int, enum_id> byte_to_enum_id;
+  enum_id enum_id_ts_base;
+  enum_id enum_id_charsets_base;
+  enum_id enum_id_literals_base;
+  enum_id enum_id_nts_base;
+
+  // what the parser does for a (nonterm, lookahead); expands the rule, except that
+  // a leading terminal is replaced by the lookahead itself, and that a repetition
+  // helper (X[n] -> x X[n]) stays on the stack as a loop instead of being pushed again.
+  struct parse_action {
+    rule_id rid;
+    bool leads_with_lookahead;
+    bool loops;
+  };
+  std::vector<parse_action> actions;
+
+  // terminals that select the same action of every nonterm share a class;
+  // term_class is indexed by the enum id of the terminal.
+  std::vector<std::size_t> term_class;
+  std::size_t class_count;
+  // action_table[nonterm - enum_id_nts_base][class] or no_action on the error.
+  std::vector<std::vector<std::size_t>> action_table;
+
+  // the table backend looks the rule up from the comb vector.
+  bool comb_table;
+
+  // with -d, the lexemes that are regular run through a minimized DFA, the scanner,
+  // instead of the prediction stack. scanner_next[state][scanner class] is scanner_error,
+  // scanner_done with the lookahead past the lexeme, or the next state + scanner_first_state;
+  // the generated table holds the offset of the row of the state instead, see scanner_value.
+  std::unordered_map<token_id, std::size_t> scanner_start;
+  std::vector<std::vector<std::size_t>> scanner_next;
+  // the class of each terminal, and at the end of the kinds out of the terminals.
+  std::vector<std::size_t> scanner_class;
+  std::size_t scanner_class_count;
+  // the bytes a state loops on, as the ranges of either the bytes that stay in the
+  // state or the bytes that stop it, whichever takes fewer; ryx_dfa_skip skips them at
+  // once. scanner_run[state] is 0 or the index + 1 of the run in scanner_runs.
+  struct byte_run {
+    std::vector<std::pair<int, int>> ranges;
+    bool stops;
+  };
+  std::vector<byte_run> scanner_runs;
+  std::vector<std::size_t> scanner_run;
+  // the nonterms the prediction stack may still hold; the ones inside a scanner are not.
+  std::unordered_set<token_id> stacked_nonterms;
+
+  // with -s, :ws*: is skipped in place while the lookahead is in trivia_classes;
+  // false if no rule has it.
+  // trivia_end_classes are the lookaheads :ws*: may stop at.
+  bool trivia;
+  std::set<std::size_t> trivia_classes;
+  std::set<std::size_t> trivia_end_classes;
+
+  // the arena is threaded through the runtime as the first argument.
+  std::string arena_arg;
+  std::string arena_param;
+
+  // what the entry points return; the events build no tree.
+  std::string result_type;
+  // the user data of the events, taken by the entry points that have none.
+  std::string data_param;
+
+
+  void emit_prologue(void) {
+    header << "// Copyright (C) 2018 pixie-grasper"
+           << "//"
+           << "// This program is free software: you can redistribute it and/or modify"
+           << "// it under the terms of the GNU General Public License as published by"
+           << "// the Free Software Foundation, either version 3 of the License, or"
+           << "// (at your option) any later version."
+           << "//"
+           << "// This program is distributed in the hope that it will be useful,"
+           << "// but WITHOUT ANY WARRANTY; without even the implied warranty of"
+           << "// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the"
+           << "// GNU General Public License for more details."
+           << "//"
+           << "// You should have received a copy of the GNU General Public License"
+           << "// along with this program.  If not, see <https://www.gnu.org/licenses/>."
+           << "";
+
+    ccfile << "// Copyright (C) 2018 pixie-grasper"
+           << "//"
+           << "// This program is free software: you can redistribute it and/or modify"
+           << "// it under the terms of the GNU General Public License as published by"
+           << "// the Free Software Foundation, either version 3 of the License, or"
+           << "// (at your option) any later version."
+           << "//"
+           << "// This program is distributed in the hope that it will be useful,"
+           << "// but WITHOUT ANY WARRANTY; without even the implied warranty of"
+           << "// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the"
+           << "// GNU General Public License for more details."
+           << "//"
+           << "// You should have received a copy of the GNU General Public License"
+           << "// along with this program.  If not, see <https://www.gnu.org/licenses/>."
+           << "";
+
+    header << "#ifndef RYX_H_"
+           << "#define RYX_H_"
+           << "";
+
+    header << "#include <stdint.h>"
+           << "#include <stdlib.h>"
+           << "";
+
+    if (options.mmap_file) {
+      // 64-bit off_t on the 32-bit hosts, and madvise on the strict modes.
+      ccfile << "#ifndef _FILE_OFFSET_BITS"
+             << "#define _FILE_OFFSET_BITS 64"
+             << "#endif"
+             << "#ifndef _DEFAULT_SOURCE"
+             << "#define _DEFAULT_SOURCE"
+             << "#endif"
+             << "";
+    }
+
+    ccfile << "#include \"ryx_parse.h\""
+           << ""
+           << "#include <stdint.h>"
+           << "#include <stdio.h>"
+           << "#include <stdlib.h>"
+           << "";
+
+    if (options.scanners) {
+      // memchr and SSE2 for the runs of the scanners.
+      ccfile << "#include <string.h>"
+             << "#if defined(__SSE2__)"
+             << "#include <emmintrin.h>"
+             << "#endif"
+             << "";
+    } else if (!literals.empty()) {
+      // memcmp for the literals.
+      ccfile << "#include <string.h>"
+             << "";
+    }
+
+    if (options.mmap_file) {
+      ccfile << "#include <fcntl.h>"
+             << "#include <sys/mman.h>"
+             << "#include <sys/stat.h>"
+             << "#include <unistd.h>"
+             << "";
+    }
+
+    header << "#ifdef __cplusplus"
+           << "#define INTERN namespace {"
+           << "#define INTERN_END }"
+           << "#define EXTERN extern \"C\""
+           << "#define CAST(x,y) static_cast<x>(y)"
+           << "#if __cplusplus >= 201103L"
+           << "#define NULLPTR nullptr"
+           << "#else"
+           << "#define NULLPTR 0"
+           << "#endif"
+           << "#else"
+           << "#define INTERN static"
+           << "#define INTERN_END"
+           << "#define EXTERN extern"
+           << "#define CAST(x,y) ((x)(y))"
+           << "#define NULLPTR 0"
+           << "#endif"
+           << "";
+
+    ccfile << "#define MALLOC(t) CAST(t*, malloc(sizeof(t)))"
+           << "";
+
+    header << "typedef void* ryx_user_data;"
+           << "";
+
+    return;
+  }
+
+  void emit_enum(void) {
+    header << "enum ryx_node_kind {";
+
+    for (int i = 0; i < 256; ++i) {
+      std::string token_string{};
+      if (0x20 <= i && i <= 0x7E) {
+        token_string.push_back('\'');
+        token_string.push_back(static_cast<char>(i));
+        if (i == '\\') {
+          token_string.push_back(static_cast<char>(i));
+        }
+        token_string.push_back('\'');
+      } else {
+        token_string = "0x";
+        token_string.push_back(itoh((i & 0xF0) >> 4));
+        token_string.push_back(itoh(i & 0x0F));
+      }
+      auto&& it = token_to_id.find(token_string);
+      if (it == token_to_id.end()) {
+        continue;
+      }
+      std::size_t number = token_id_to_enum_string.size();
+      std::string enum_string = "ryx_node_kind_char_0x";
+      enum_string.push_back(itoh((i & 0xF0) >> 4));
+      enum_string.push_back(itoh(i & 0x0F));
+      std::string header_string = "  "
+                                + enum_string
+                                + " = "
+                                + std::to_string(number)
+                                + ", // "
+                                + token_string;
+      header << header_string;
+      token_id_to_enum_string[it->second] = enum_string;
+      token_id_to_enum_id[it->second] = number;
+      byte_to_enum_id[i] = number;
+    }
+
+    std::set<std::string> sorted_ts_string{};
+    for (auto&& it = terminate_symbols.begin();
+                it != terminate_symbols.end();
+                ++it) {
+      if (token_id_to_enum_string.find(*it) != token_id_to_enum_string.end()) {
+        continue;
+      } else if (*it == last_term) {
+        continue;
+      } else if (classes.find(*it) != classes.end()) {
+        continue;
+      } else if (literals.find(*it) != literals.end()) {
+        continue;
+      }
+      sorted_ts_string.insert(id_to_token.find(*it)->second);
+    }
+    enum_id_ts_base = token_id_to_enum_string.size();
+    // end of the input
+    {
+      std::size_t number = token_id_to_enum_string.size();
+      std::string enum_string = "ryx_node_kind_term_" + std::to_string(number - enum_id_ts_base);
+      std::string header_string = "  "
+                                + enum_string
+                                + " = "
+                                + std::to_string(number)
+                                + ", // $; end of the input.";
+      header << header_string;
+      token_id_to_enum_string[last_term] = enum_string;
+      token_id_to_enum_id[last_term] = number;
+    }
+    // regular TS
+    for (auto&& it = sorted_ts_string.begin(); it != sorted_ts_string.end(); ++it) {
+      std::size_t number = token_id_to_enum_string.size();
+      std::string enum_string = "ryx_node_kind_term_" + std::to_string(number - enum_id_ts_base);
+      std::string header_string = "  "
+                                + enum_string
+                                + " = "
+                                + std::to_string(number)
+                                + ", // "
+                                + *it;
+      header << header_string;
+      token_id ts_id = token_to_id.find(*it)->second;
+      token_id_to_enum_string[ts_id] = enum_string;
+      token_id_to_enum_id[ts_id] = number;
+    }
+
+    // character classes; they never come from the input, only the stack holds them.
+    std::set<std::string> sorted_class_string{};
+    for (auto&& it = classes.begin(); it != classes.end(); ++it) {
+      sorted_class_string.insert(id_to_token.at(it->first));
+    }
+    enum_id_charsets_base = token_id_to_enum_string.size();
+    for (auto&& it = sorted_class_string.begin(); it != sorted_class_string.end(); ++it) {
+      std::size_t number = token_id_to_enum_string.size();
+      std::string enum_string = "ryx_node_kind_charset_"
+                              + std::to_string(number - enum_id_charsets_base);
+      std::string header_string = "  "
+                                + enum_string
+                                + " = "
+                                + std::to_string(number)
+                                + ", // "
+                                + *it;
+      header << header_string;
+      token_id class_id = token_to_id.find(*it)->second;
+      token_id_to_enum_string[class_id] = enum_string;
+      token_id_to_enum_id[class_id] = number;
+    }
+
+    // literals; the stack holds them, and the input brings their bytes one by one.
+    std::set<std::string> sorted_literal_string{};
+    for (auto&& it = literals.begin(); it != literals.end(); ++it) {
+      sorted_literal_string.insert(id_to_token.at(it->first));
+    }
+    enum_id_literals_base = token_id_to_enum_string.size();
+    for (auto&& it = sorted_literal_string.begin(); it != sorted_literal_string.end(); ++it) {
+      std::size_t number = token_id_to_enum_string.size();
+      std::string enum_string = "ryx_node_kind_literal_"
+                              + std::to_string(number - enum_id_literals_base);
+      std::string header_string = "  "
+                                + enum_string
+                                + " = "
+                                + std::to_string(number)
+                                + ", // "
+                                + *it;
+      header << header_string;
+      token_id literal_id = token_to_id.find(*it)->second;
+      token_id_to_enum_string[literal_id] = enum_string;
+      token_id_to_enum_id[literal_id] = number;
+    }
+
+    std::set<std::string> sorted_nts_string{};
+    for (auto&& it = non_terminate_symbols.begin();
+                it != non_terminate_symbols.end();
+                ++it) {
+      sorted_nts_string.insert(id_to_token.at(*it));
+    }
+    enum_id_nts_base = token_id_to_enum_string.size();
+    // stack top at the begins
+    {
+      std::size_t number = token_id_to_enum_string.size();
+      std::string enum_string = "ryx_node_kind_nonterm_"
+                              + std::to_string(number - enum_id_nts_base);
+      std::string header_string = "  "
+                                + enum_string
+                                + " = "
+                                + std::to_string(number)
+                                + ", // stack top at the begins.";
+      header << header_string;
+      token_id_to_enum_string[first_nonterm] = enum_string;
+      token_id_to_enum_id[first_nonterm] = number;
+    }
+    // special token
+    {
+      std::size_t number = token_id_to_enum_string.size();
+      std::string enum_string = "ryx_node_kind_nonterm_"
+                              + std::to_string(number - enum_id_nts_base);
+      std::string header_string = "  "
+                                + enum_string
+                                + " = "
+                                + std::to_string(number)
+                                + ", // special token.";
+      header << header_string;
+      token_id_to_enum_string[special_token] = enum_string;
+      token_id_to_enum_id[special_token] = number;
+    }
+    // regular NTS
+    for (auto&& it = sorted_nts_string.begin(); it != sorted_nts_string.end(); ++it) {
+      std::size_t number = token_id_to_enum_string.size();
+      std::string enum_string = "ryx_node_kind_nonterm_"
+                              + std::to_string(number - enum_id_nts_base);
+      std::string header_string = "  "
+                                + enum_string
+                                + " = "
+                                + std::to_string(number)
+                                + ", // "
+                                + *it;
+      token_id nts_id = token_to_id.find(*it)->second;
+      if (nts_id == first_nonterm) {
+        continue;
+      }
+      header << header_string;
+      token_id_to_enum_string[nts_id] = enum_string;
+      token_id_to_enum_id[nts_id] = number;
+    }
+
+    // the kind of the bytes the grammar does not use; out of the terminals, so no rule
+    // takes it.
+    std::size_t none = token_id_to_enum_string.size();
+    header << "  ryx_node_kind_none = " + std::to_string(none) + ", // a byte not in the grammar.";
+
+    // the counts of the repetitions sit on the stack among the kinds.
+    std::size_t max_count = 0;
+    for (auto&& it = repeats.begin(); it != repeats.end(); ++it) {
+      max_count = std::max(max_count, it->second.second);
+    }
+    if (max_count > none) {
+      header << "  ryx_node_kind_count_limit = " + std::to_string(max_count)
+                + ", // the largest count of a repetition.";
+    }
+
+    for (auto&& it = token_id_to_enum_id.begin(); it != token_id_to_enum_id.end(); ++it) {
+      enum_id_to_token_id[it->second] = it->first;
+    }
+
+    header << "};"
+           << "";
+
+    return;
+  }
+
+  void emit_runtime(void) {
+    header << "struct ryx_token {"
+           << "  enum ryx_node_kind kind;"
+           << "  ryx_user_data data;"
+           << "  void (*free)(struct ryx_token* token);"
+           << "};"
+           << "";
+
+    if (options.flat_tree) {
+      // the nodes in preorder; node i covers i .. i + subtree_size[i] of the arrays.
+      header << "struct ryx_tree;"
+             << ""
+             << "#define RYX_NO_NODE 0xFFFFFFFFu"
+             << ""
+             << "struct ryx_flat_tree {"
+             << "  size_t size;"
+             << "  " + kind_type() + "* kind;"
+             << "  uint32_t* parent;  // RYX_NO_NODE on the root."
+             << "  uint32_t* subtree_size;"
+             << "  size_t* begin_offset;"
+             << "  size_t* end_offset;";
+      if (trivia) {
+        header << "  size_t trivia_size;"
+               << "  size_t* trivia;  // the begin and the end of each span :ws*: skipped.";
+      }
+      header << "};"
+             << "";
+
+      // tokens is allocated on the first token that is not shared;
+      // nodes are the handles of ryx_get_sub_node and others, made at the end.
+      ccfile << "struct ryx_flat {"
+             << "  struct ryx_flat_tree tree;"
+             << "  size_t capacity;"
+             << "  int full;  // a node went past RYX_FLAT_MAX_NODES.";
+      if (trivia) {
+        ccfile << "  size_t trivia_capacity;";
+      }
+      ccfile << "  struct ryx_token** tokens;"
+             << "  struct ryx_tree* nodes;"
+             << "};"
+             << "";
+
+      ccfile << "struct ryx_tree {"
+             << "  struct ryx_flat* flat;"
+             << "};"
+             << "";
+    } else if (!options.events) {
+      header << "struct ryx_tree;"
+             << "";
+
+      ccfile << "struct ryx_tree {"
+             << "  struct ryx_token* token;"
+             << "  struct ryx_tree* parent_node;"
+             << "  struct ryx_tree* next_node;"
+             << "  struct ryx_tree* sub_node_first;"
+             << "  struct ryx_tree* sub_node_last;"
+             << "  size_t offset;";
+      if (options.leaves) {
+        ccfile << "  size_t end_offset;";
+      }
+      ccfile << "};"
+             << "";
+    }
+
+    ccfile << "#ifndef RYX_STACK_INITIAL_CAPACITY"
+           << "#define RYX_STACK_INITIAL_CAPACITY 256"
+           << "#endif"
+           << "";
+
+    ccfile << "struct ryx_stack {"
+           << "  enum ryx_node_kind* kinds;"
+           << "  size_t size;"
+           << "  size_t capacity;"
+           << "};"
+           << "";
+
+    // the input is either the user callback or a caller-owned byte buffer.
+    ccfile << "struct ryx_input {"
+           << "  ryx_user_data data;"
+           << "  const unsigned char* cursor;  // NULLPTR on the callback."
+           << "  const unsigned char* end;"
+           << "  size_t offset;"
+           << "  int last;  // the end of the buffer is the end of the input."
+           << "};"
+           << "";
+
+    // the prediction stack and the tree cursor survive between the chunks;
+    // lexeme counts the lexeme nonterms open, only the outermost of which makes a node.
+    if (options.flat_tree) {
+      ccfile << "struct ryx_parser {"
+             << "  struct ryx_stack stack;"
+             << "  struct ryx_flat* tree;"
+             << "  size_t node;";
+      emit_lexeme_state();
+      ccfile << "  size_t offset;"
+             << "  int done;"
+             << "};"
+             << "";
+    } else if (options.events) {
+      // open holds the nonterms entered and not exited yet.
+      ccfile << "struct ryx_parser {"
+             << "  struct ryx_stack stack;"
+             << "  struct ryx_stack open;"
+             << "  ryx_user_data data;"
+             << "  int accepted;";
+      emit_lexeme_state();
+      ccfile << "  size_t offset;"
+             << "  int done;"
+             << "};"
+             << "";
+    } else {
+      ccfile << "struct ryx_parser {"
+             << "  struct ryx_stack stack;"
+             << "  struct ryx_tree* tree;"
+             << "  struct ryx_tree* node;";
+      emit_lexeme_state();
+      ccfile << "  size_t offset;"
+             << "  int done;"
+             << "};"
+             << "";
+    }
+    if (options.arena) {
+      ccfile << "#ifndef RYX_ARENA_CHUNK_SIZE"
+             << "#define RYX_ARENA_CHUNK_SIZE 65536"
+             << "#endif"
+             << ""
+             << "#define ARENA_MALLOC(a,t) CAST(t*, ryx_arena_alloc((a), sizeof(t)))"
+             << "";
+
+      ccfile << "struct ryx_arena_chunk {"
+             << "  struct ryx_arena_chunk* next;"
+             << "  size_t used;"
+             << "  size_t size;"
+             << "};"
+             << "";
+
+      ccfile << "struct ryx_arena {"
+             << "  struct ryx_arena_chunk* chunk;"
+             << "  struct ryx_token** tokens;"
+             << "  size_t tokens_size;"
+             << "  size_t tokens_capacity;"
+             << "};"
+             << "";
+
+      ccfile << "struct ryx_tree_root {"
+             << "  struct ryx_tree tree;"
+             << "  struct ryx_arena arena;"
+             << "};"
+             << "";
+    }
+
+    header << "// TODO: need to implement yourself!"
+           << "EXTERN struct ryx_token* ryx_get_next_token(ryx_user_data input);";
+    if (options.events) {
+      // the token belongs to the parser; it is freed after the call.
+      header << "EXTERN void ryx_on_enter(ryx_user_data data, enum ryx_node_kind kind, size_t offset);"
+             << "EXTERN void ryx_on_exit(ryx_user_data data, enum ryx_node_kind kind);"
+             << "EXTERN void ryx_on_terminal(ryx_user_data data, struct ryx_token* token, size_t offset);";
+      if (options.leaves) {
+        // in place of the enter, the exit and the terminals between them.
+        header << "EXTERN void ryx_on_lexeme(ryx_user_data data, enum ryx_node_kind kind, size_t begin, size_t end);";
+      }
+      if (trivia) {
+        // each span of the whitespace skipped in place of :ws*:.
+        header << "EXTERN void ryx_on_trivia(ryx_user_data data, size_t begin, size_t end);";
+      }
+    }
+    header << "";
+
+    header << "// RYX interface begin";
+
+    if (options.arena) {
+      ccfile << "INTERN"
+             << "void* ryx_arena_alloc(struct ryx_arena* arena, size_t size) {"
+             << "  struct ryx_arena_chunk* chunk;"
+             << "  size_t chunk_size;"
+             << "  char* ret;"
+             << ""
+             << "  size = (size + sizeof(void*) - 1) & ~(sizeof(void*) - 1);"
+             << "  chunk = arena->chunk;"
+             << "  if (chunk == NULLPTR || chunk->size - chunk->used < size) {"
+             << "    chunk_size = RYX_ARENA_CHUNK_SIZE;"
+             << "    if (chunk_size < size) {"
+             << "      chunk_size = size;"
+             << "    }"
+             << "    chunk = CAST(struct ryx_arena_chunk*,"
+             << "                 malloc(sizeof(struct ryx_arena_chunk) + chunk_size));"
+             << "    chunk->next = arena->chunk;"
+             << "    chunk->used = 0;"
+             << "    chunk->size = chunk_size;"
+             << "    arena->chunk = chunk;"
+             << "  }"
+             << ""
+             << "  ret = CAST(char*, CAST(void*, chunk + 1)) + chunk->used;"
+             << "  chunk->used += size;"
+             << ""
+             << "  return ret;"
+             << "}"
+             << "INTERN_END"
+             << "";
+
+      ccfile << "INTERN"
+             << "void ryx_arena_add_token(struct ryx_arena* arena, struct ryx_token* token) {"
+             << "  if (arena->tokens_size == arena->tokens_capacity) {"
+             << "    arena->tokens_capacity = arena->tokens_capacity * 2 + 64;"
+             << "    arena->tokens = CAST(struct ryx_token**,"
+             << "                         realloc(arena->tokens,"
+             << "                                 sizeof(struct ryx_token*) * arena->tokens_capacity));"
+             << "  }"
+             << "  arena->tokens[arena->tokens_size++] = token;"
+             << ""
+             << "  return;"
+             << "}"
+             << "INTERN_END"
+             << "";
+
+      ccfile << "INTERN"
+             << "void ryx_free_internal_token(struct ryx_token* token) {"
+             << "  // owned by the arena."
+             << "  (void)token;"
+             << "  return;"
+             << "}"
+             << "INTERN_END"
+             << "";
+    } else if (!options.events && !options.flat_tree) {
+      ccfile << "INTERN"
+             << "void ryx_free_internal_token(struct ryx_token* token) {"
+             << "  free(token);"
+             << "  return;"
+             << "}"
+             << "INTERN_END"
+             << "";
+    }
+
+    ccfile << "INTERN"
+           << "void ryx_free_static_token(struct ryx_token* token) {"
+           << "  // shared by every parse; never freed."
+           << "  (void)token;"
+           << "  return;"
+           << "}"
+           << "INTERN_END"
+           << "";
+
+    ccfile << "INTERN"
+           << "void ryx_token_free(struct ryx_token* token) {"
+           << "  if (token->free != NULLPTR) {"
+           << "    token->free(token);"
+           << "  } else {"
+           << "    free(token->data);"
+           << "    free(token);"
+           << "  }"
+           << ""
+           << "  return;"
+           << "}"
+           << "INTERN_END"
+           << "";
+
+    if (options.arena) {
+      ccfile << "INTERN"
+             << "struct ryx_token* ryx_make_internal_token(struct ryx_arena* arena,"
+             << "                                          enum ryx_node_kind kind) {"
+             << "  struct ryx_token* token;"
+             << ""
+             << "  token = ARENA_MALLOC(arena, struct ryx_token);"
+             << "  token->kind = kind;"
+             << "  token->data = NULLPTR;"
+             << "  token->free = ryx_free_internal_token;"
+             << ""
+             << "  return token;"
+             << "}"
+             << "INTERN_END"
+             << "";
+    } else if (!options.events && !options.flat_tree) {
+      ccfile << "INTERN"
+             << "struct ryx_token* ryx_make_internal_token(enum ryx_node_kind kind) {"
+             << "  struct ryx_token* token;"
+             << ""
+             << "  token = MALLOC(struct ryx_token);"
+             << "  token->kind = kind;"
+             << "  token->data = NULLPTR;"
+             << "  token->free = ryx_free_internal_token;"
+             << ""
+             << "  return token;"
+             << "}"
+             << "INTERN_END"
+             << "";
+    }
+
+    ccfile << "INTERN"
+           << "void ryx_stack_init(struct ryx_stack* stack) {"
+           << "  stack->kinds = CAST(enum ryx_node_kind*,"
+           << "                      malloc(sizeof(enum ryx_node_kind) * RYX_STACK_INITIAL_CAPACITY));"
+           << "  stack->size = 0;"
+           << "  stack->capacity = RYX_STACK_INITIAL_CAPACITY;"
+           << ""
+           << "  return;"
+           << "}"
+           << "INTERN_END"
+           << "";
+
+    // makes room for n more symbols; the capacity doubles on overflow.
+    ccfile << "INTERN"
+           << "void ryx_stack_reserve(struct ryx_stack* stack, size_t n) {"
+           << "  if (stack->capacity - stack->size >= n) {"
+           << "    return;"
+           << "  }"
+           << ""
+           << "  while (stack->capacity - stack->size < n) {"
+           << "    stack->capacity *= 2;"
+           << "  }"
+           << "  stack->kinds = CAST(enum ryx_node_kind*,"
+           << "                      realloc(stack->kinds,"
+           << "                              sizeof(enum ryx_node_kind) * stack->capacity));"
+           << ""
+           << "  return;"
+           << "}"
+           << "INTERN_END"
+           << "";
+
+    ccfile << "INTERN"
+           << "void ryx_stack_free(struct ryx_stack* stack) {"
+           << "  free(stack->kinds);"
+           << "  stack->kinds = NULLPTR;"
+           << "  stack->size = 0;"
+           << "  stack->capacity = 0;"
+           << ""
+           << "  return;"
+           << "}"
+           << "INTERN_END"
+           << "";
+
+    if (options.flat_tree) {
+      emit_flat_runtime();
+    } else if (!options.events) {
+      emit_tree_runtime();
+    }
+
+    return;
+  }
+
+  std::string kind_type(void) {
+    return enum_id_to_token_id.size() <= 0xFFFF ? "uint16_t" : "uint32_t";
+  }
+
+  void emit_flat_runtime(void) {
+    std::string kind_array = "CAST(" + kind_type() + "*, ";
+
+    ccfile << "#ifndef RYX_FLAT_INITIAL_CAPACITY"
+           << "#define RYX_FLAT_INITIAL_CAPACITY 1024"
+           << "#endif"
+           << ""
+           << "// the indices are 32 bits, and RYX_NO_NODE is not one of them."
+           << "#ifndef RYX_FLAT_MAX_NODES"
+           << "#define RYX_FLAT_MAX_NODES 0xFFFFFFFFu"
+           << "#endif"
+           << "";
+
+    // the nonterms and the shared terminals answer ryx_get_token with these.
+    ccfile << "INTERN"
+           << "struct ryx_token ryx_kind_tokens[" + std::to_string(enum_id_to_token_id.size()) + "] = {";
+    for (enum_id eid = 0; eid < enum_id_to_token_id.size(); ++eid) {
+      ccfile << "  {" + token_id_to_enum_string[enum_id_to_token_id[eid]]
+                + ", NULLPTR, ryx_free_static_token},";
+    }
+    ccfile << "};"
+           << "INTERN_END"
+           << "";
+
+    ccfile << "INTERN"
+           << "struct ryx_flat* ryx_flat_new(void) {"
+           << "  struct ryx_flat* flat;"
+           << ""
+           << "  flat = MALLOC(struct ryx_flat);"
+           << "  flat->capacity = RYX_FLAT_INITIAL_CAPACITY;"
+           << "  flat->full = 0;"
+           << "  flat->tree.size = 0;"
+           << "  flat->tree.kind = " + kind_array + "malloc(sizeof(" + kind_type() + ") * flat->capacity));"
+           << "  flat->tree.parent = CAST(uint32_t*, malloc(sizeof(uint32_t) * flat->capacity));"
+           << "  flat->tree.subtree_size = CAST(uint32_t*, malloc(sizeof(uint32_t) * flat->capacity));"
+           << "  flat->tree.begin_offset = CAST(size_t*, malloc(sizeof(size_t) * flat->capacity));"
+           << "  flat->tree.end_offset = CAST(size_t*, malloc(sizeof(size_t) * flat->capacity));";
+    if (trivia) {
+      ccfile << "  flat->tree.trivia_size = 0;"
+             << "  flat->tree.trivia = NULLPTR;"
+             << "  flat->trivia_capacity = 0;";
+    }
+    ccfile << "  flat->tokens = NULLPTR;"
+           << "  flat->nodes = NULLPTR;"
+           << ""
+           << "  return flat;"
+           << "}"
+           << "INTERN_END"
+           << "";
+
+    // to double the capacity while parsing, and to fit it to the size at the end.
+    ccfile << "INTERN"
+           << "void ryx_flat_resize(struct ryx_flat* flat, size_t capacity) {"
+           << "  size_t i;"
+           << ""
+           << "  flat->capacity = capacity;"
+           << "  flat->tree.kind = " + kind_array + "realloc(flat->tree.kind,"
+           << "      sizeof(" + kind_type() + ") * flat->capacity));"
+           << "  flat->tree.parent = CAST(uint32_t*, realloc(flat->tree.parent,"
+           << "      sizeof(uint32_t) * flat->capacity));"
+           << "  flat->tree.subtree_size = CAST(uint32_t*, realloc(flat->tree.subtree_size,"
+           << "      sizeof(uint32_t) * flat->capacity));"
+           << "  flat->tree.begin_offset = CAST(size_t*, realloc(flat->tree.begin_offset,"
+           << "      sizeof(size_t) * flat->capacity));"
+           << "  flat->tree.end_offset = CAST(size_t*, realloc(flat->tree.end_offset,"
+           << "      sizeof(size_t) * flat->capacity));"
+           << "  if (flat->tokens != NULLPTR) {"
+           << "    flat->tokens = CAST(struct ryx_token**, realloc(flat->tokens,"
+           << "        sizeof(struct ryx_token*) * flat->capacity));"
+           << "    for (i = flat->tree.size; i < flat->capacity; ++i) {"
+           << "      flat->tokens[i] = NULLPTR;"
+           << "    }"
+           << "  }"
+           << ""
+           << "  return;"
+           << "}"
+           << "INTERN_END"
+           << "";
+
+    // a node past RYX_FLAT_MAX_NODES is still added, so the parse goes on safely, but the
+    // tree is full and ryx_flat_finish drops it.
+    ccfile << "INTERN"
+           << "void ryx_flat_add(struct ryx_flat* flat, size_t parent,"
+           << "                  enum ryx_node_kind kind, size_t offset) {"
+           << "  size_t i;"
+           << ""
+           << "  if (flat->tree.size >= RYX_FLAT_MAX_NODES) {"
+           << "    flat->full = 1;"
+           << "  }"
+           << "  if (flat->tree.size == flat->capacity) {"
+           << "    ryx_flat_resize(flat, flat->capacity * 2);"
+           << "  }"
+           << "  i = flat->tree.size++;"
+           << "  flat->tree.kind[i] = CAST(" + kind_type() + ", kind);"
+           << "  flat->tree.parent[i] = CAST(uint32_t, parent);"
+           << "  flat->tree.subtree_size[i] = 1;"
+           << "  flat->tree.begin_offset[i] = offset;"
+           << "  flat->tree.end_offset[i] = offset;"
+           << ""
+           << "  return;"
+           << "}"
+           << "INTERN_END"
+           << "";
+
+    ccfile << "INTERN"
+           << "void ryx_flat_add_token(struct ryx_flat* flat, size_t parent,"
+           << "                        struct ryx_token* token, size_t offset) {"
+           << "  size_t i;"
+           << ""
+           << "  ryx_flat_add(flat, parent, token->kind, offset);"
+           << "  flat->tree.end_offset[flat->tree.size - 1] = offset + 1;"
+           << "  if (token->free != ryx_free_static_token) {"
+           << "    if (flat->tokens == NULLPTR) {"
+           << "      flat->tokens = CAST(struct ryx_token**,"
+           << "                          malloc(sizeof(struct ryx_token*) * flat->capacity));"
+           << "      for (i = 0; i < flat->capacity; ++i) {"
+           << "        flat->tokens[i] = NULLPTR;"
+           << "      }"
+           << "    }"
+           << "    flat->tokens[flat->tree.size - 1] = token;"
+           << "  }"
+           << ""
+           << "  return;"
+           << "}"
+           << "INTERN_END"
+           << "";
+
+    // the node ends at the lookahead.
+    ccfile << "INTERN"
+           << "size_t ryx_flat_close(struct ryx_flat* flat, size_t node, size_t offset) {"
+           << "  flat->tree.subtree_size[node] = CAST(uint32_t, flat->tree.size - node);"
+           << "  flat->tree.end_offset[node] = offset;"
+           << ""
+           << "  return flat->tree.parent[node];"
+           << "}"
+           << "INTERN_END"
+           << "";
+
+    if (trivia) {
+      ccfile << "INTERN"
+             << "void ryx_flat_add_trivia(struct ryx_flat* flat, size_t begin, size_t end) {"
+             << "  if (flat->tree.trivia_size * 2 == flat->trivia_capacity) {"
+             << "    flat->trivia_capacity = flat->trivia_capacity == 0 ? 64 : flat->trivia_capacity * 2;"
+             << "    flat->tree.trivia = CAST(size_t*, realloc(flat->tree.trivia,"
+             << "        sizeof(size_t) * flat->trivia_capacity));"
+             << "  }"
+             << "  flat->tree.trivia[flat->tree.trivia_size * 2] = begin;"
+             << "  flat->tree.trivia[flat->tree.trivia_size * 2 + 1] = end;"
+             << "  flat->tree.trivia_size += 1;"
+             << ""
+             << "  return;"
+             << "}"
+             << "INTERN_END"
+             << "";
+    }
+
+    ccfile << "INTERN"
+           << "void ryx_flat_free(struct ryx_flat* flat) {"
+           << "  size_t i;"
+           << ""
+           << "  if (flat == NULLPTR) {"
+           << "    return;"
+           << "  }"
+           << ""
+           << "  if (flat->tokens != NULLPTR) {"
+           << "    for (i = 0; i < flat->tree.size; ++i) {"
+           << "      if (flat->tokens[i] != NULLPTR) {"
+           << "        ryx_token_free(flat->tokens[i]);"
+           << "      }"
+           << "    }"
+           << "    free(flat->tokens);"
+           << "  }"
+           << "  free(flat->tree.kind);"
+           << "  free(flat->tree.parent);"
+           << "  free(flat->tree.subtree_size);"
+           << "  free(flat->tree.begin_offset);"
+           << "  free(flat->tree.end_offset);";
+    if (trivia) {
+      ccfile << "  free(flat->tree.trivia);";
+    }
+    ccfile << "  free(flat->nodes);"
+           << "  free(flat);"
+           << ""
+           << "  return;"
+           << "}"
+           << "INTERN_END"
+           << "";
+
+    ccfile << "INTERN"
+           << "struct ryx_tree* ryx_flat_finish(struct ryx_flat* flat) {"
+           << "  size_t i;"
+           << ""
+           << "  if (flat == NULLPTR) {"
+           << "    return NULLPTR;"
+           << "  } else if (flat->full) {"
+           << "    ryx_flat_free(flat);"
+           << "    return NULLPTR;"
+           << "  }"
+           << ""
+           << "  ryx_flat_resize(flat, flat->tree.size);"
+           << "  flat->nodes = CAST(struct ryx_tree*, malloc(sizeof(struct ryx_tree) * flat->tree.size));"
+           << "  for (i = 0; i < flat->tree.size; ++i) {"
+           << "    flat->nodes[i].flat = flat;"
+           << "  }"
+           << ""
+           << "  return &flat->nodes[0];"
+           << "}"
+           << "INTERN_END"
+           << "";
+
+    // frees the whole tree the node belongs to.
+    header << "EXTERN void ryx_tree_free(struct ryx_tree* tree);";
+    ccfile << "EXTERN void ryx_tree_free(struct ryx_tree* tree) {"
+           << "  if (tree == NULLPTR) {"
+           << "    return;"
+           << "  }"
+           << ""
+           << "  ryx_flat_free(tree->flat);"
+           << ""
+           << "  return;"
+           << "}"
+           << "";
+
+    return;
+  }
+
+  void emit_tree_runtime(void) {
+    std::string tree_malloc = options.arena ? "ARENA_MALLOC(arena, struct ryx_tree)"
+                                            : "MALLOC(struct ryx_tree)";
+    ccfile << "INTERN"
+           << "struct ryx_tree* ryx_tree_add_right_token(" + arena_param + "struct ryx_tree* tree,"
+           << "                                          struct ryx_token* token,"
+           << "                                          size_t offset) {"
+           << "  if (tree->sub_node_last == NULLPTR) {"
+           << "    tree->sub_node_first = " + tree_malloc + ";"
+           << "    tree->sub_node_last = tree->sub_node_first;"
+           << "  } else {"
+           << "    tree->sub_node_last->next_node = " + tree_malloc + ";"
+           << "    tree->sub_node_last = tree->sub_node_last->next_node;"
+           << "  }"
+           << ""
+           << "  tree->sub_node_last->token = token;"
+           << "  tree->sub_node_last->parent_node = tree;"
+           << "  tree->sub_node_last->next_node = NULLPTR;"
+           << "  tree->sub_node_last->sub_node_first = NULLPTR;"
+           << "  tree->sub_node_last->sub_node_last = NULLPTR;"
+           << "  tree->sub_node_last->offset = offset;";
+    if (options.leaves) {
+      ccfile << "  tree->sub_node_last->end_offset = offset + 1;";
+    }
+    ccfile << ""
+           << "  return tree;"
+           << "}"
+           << "INTERN_END"
+           << "";
+
+    ccfile << "INTERN"
+           << "struct ryx_tree* ryx_tree_add_right(" + arena_param + "struct ryx_tree* tree,"
+           << "                                    enum ryx_node_kind kind,"
+           << "                                    size_t offset) {";
+    if (options.leaves) {
+      // the nonterm ends where its <end-of-body> pops.
+      ccfile << "  ryx_tree_add_right_token(" + arena_arg + "tree, ryx_make_internal_token("
+                + arena_arg + "kind), offset);"
+             << "  tree->sub_node_last->end_offset = offset;"
+             << ""
+             << "  return tree;";
+    } else {
+      ccfile << "  return ryx_tree_add_right_token(" + arena_arg + "tree, ryx_make_internal_token("
+                + arena_arg + "kind), offset);";
+    }
+    ccfile << "}"
+           << "INTERN_END"
+           << "";
+
+    if (options.arena) {
+      // the user tokens are the only memory the arena does not own.
+      header << "EXTERN void ryx_tree_free(struct ryx_tree* tree);";
+      ccfile << "EXTERN void ryx_tree_free(struct ryx_tree* tree) {"
+             << "  struct ryx_tree_root* root;"
+             << "  struct ryx_arena_chunk* chunk;"
+             << "  size_t i;"
+             << ""
+             << "  if (tree == NULLPTR) {"
+             << "    return;"
+             << "  }"
+             << ""
+             << "  root = CAST(struct ryx_tree_root*, CAST(void*, tree));"
+             << "  for (i = 0; i < root->arena.tokens_size; ++i) {"
+             << "    ryx_token_free(root->arena.tokens[i]);"
+             << "  }"
+             << "  free(root->arena.tokens);"
+             << "  while (root->arena.chunk != NULLPTR) {"
+             << "    chunk = root->arena.chunk->next;"
+             << "    free(root->arena.chunk);"
+             << "    root->arena.chunk = chunk;"
+             << "  }"
+             << "  free(root);"
+             << ""
+             << "  return;"
+             << "}"
+             << "";
+    } else {
+      header << "EXTERN void ryx_tree_free(struct ryx_tree* tree);";
+      ccfile << "EXTERN void ryx_tree_free(struct ryx_tree* tree) {"
+             << "  struct ryx_tree* node;"
+             << ""
+             << "  if (tree == NULLPTR) {"
+             << "    return;"
+             << "  }"
+             << ""
+             << "  while (tree != NULLPTR) {"
+             << "    ryx_tree_free(tree->sub_node_first);"
+             << "    ryx_token_free(tree->token);"
+             << "    node = tree->next_node;"
+             << "    free(tree);"
+             << "    tree = node;"
+             << "  }"
+             << ""
+             << "  return;"
+             << "}"
+             << "";
+    }
+
+    return;
+  }
+
+  // the events report a lexeme once it closes, from where it began.
+  // dfa is the state of the scanner the lexeme on the top is in, or 0.
+  void emit_lexeme_state(void) {
+    if (options.leaves) {
+      ccfile << "  size_t lexeme;";
+      if (options.events) {
+        ccfile << "  size_t lexeme_begin;";
+      }
+    }
+    if (!scanner_start.empty()) {
+      ccfile << "  size_t dfa;";
+    }
+    if (trivia) {
+      ccfile << "  size_t trivia;  // 1 + where the skipped whitespace begins, or 0.";
+    }
+    if (!literals.empty()) {
+      ccfile << "  size_t literal;  // the bytes of the literal on the top matched so far.";
+    }
+    return;
+  }
+
+  // one shared token per byte, so that a buffer is parsed without allocating any.
+  void emit_input(void) {
+    ccfile << "INTERN"
+           << "struct ryx_token ryx_byte_tokens[256] = {";
+    for (int i = 0; i < 256; ++i) {
+      auto&& it = byte_to_enum_id.find(i);
+      if (it == byte_to_enum_id.end()) {
+        // ryx_class_of gives no class to it, so the byte is rejected.
+        ccfile << "  {ryx_node_kind_none, NULLPTR, ryx_free_static_token},  // not in the grammar.";
+      } else {
+        ccfile << "  {" + token_id_to_enum_string[enum_id_to_token_id[it->second]]
+                  + ", NULLPTR, ryx_free_static_token},";
+      }
+    }
+    ccfile << "};"
+           << "INTERN_END"
+           << "";
+
+    ccfile << "INTERN"
+           << "struct ryx_token ryx_end_token = {"
+           << "  " + token_id_to_enum_string[last_term] + ", NULLPTR, ryx_free_static_token"
+           << "};"
+           << "INTERN_END"
+           << "";
+
+    // offset is the index of the token in the input; the byte offset on a buffer.
+    ccfile << "INTERN"
+           << "struct ryx_token* ryx_input_next(struct ryx_input* input, size_t* offset) {"
+           << "  if (input->cursor == NULLPTR) {"
+           << "    *offset = input->offset++;"
+           << "    return ryx_get_next_token(input->data);"
+           << "  } else if (input->cursor != input->end) {"
+           << "    *offset = input->offset++;"
+           << "    return &ryx_byte_tokens[*input->cursor++];"
+           << "  } else if (input->last) {"
+           << "    *offset = input->offset++;"
+           << "    return &ryx_end_token;"
+           << "  } else {"
+           << "    // the chunk ran dry; the parser waits for the next one."
+           << "    return NULLPTR;"
+           << "  }"
+           << "}"
+           << "INTERN_END"
+           << "";
+
+    return;
+  }
+
+  bool is_generated(token_id nts_tid) {
+    auto&& name = id_to_token.at(nts_tid);
+    return name.back() == ']' || name.back() == '/';
+  }
+
+  bool is_lexeme(token_id nts_tid) {
+    return options.leaves && lexemes.find(nts_tid) != lexemes.end();
+  }
+
+  // the smallest unsigned type that holds max.
+  static std::string uint_type_for(std::size_t max) {
+    if (max <= 0xFF) {
+      return "uint8_t";
+    } else if (max <= 0xFFFF) {
+      return "uint16_t";
+    } else {
+      return "uint32_t";
+    }
+  }
+
+  // emits values as the body of an array initializer, 16 values per line.
+  void emit_array_values(const std::vector<std::size_t>& values) {
+    std::string line{};
+    for (std::size_t i = 0; i < values.size(); ++i) {
+      if (i % 16 == 0) {
+        line = " ";
+      }
+      line += " " + std::to_string(values[i]) + ",";
+      if (i % 16 == 15 || i + 1 == values.size()) {
+        ccfile << line;
+      }
+    }
+    return;
+  }
+
+  // overlaps the rows of the dense table so that no two non-error entries
+  // share a slot; the row r owns value[base[r] + t] iff check[base[r] + t] == r.
+  // rows are placed in the order of decreasing population, each at the first fit.
+  static void pack_comb(const std::vector<std::size_t>& dense,
+                        std::size_t row_count,
+                        std::size_t column_count,
+                        std::vector<std::size_t>* base,
+                        std::vector<std::size_t>* check,
+                        std::vector<std::size_t>* value) {
+    std::vector<std::vector<std::size_t>> columns(row_count);
+    for (std::size_t row = 0; row < row_count; ++row) {
+      for (std::size_t column = 0; column < column_count; ++column) {
+        if (dense[row * column_count + column] != 0) {
+          columns[row].push_back(column);
+        }
+      }
+    }
+    std::vector<std::size_t> order(row_count);
+    for (std::size_t row = 0; row < row_count; ++row) {
+      order[row] = row;
+    }
+    std::stable_sort(order.begin(), order.end(), [&](std::size_t lhs, std::size_t rhs) {
+      return columns[lhs].size() > columns[rhs].size();
+    });
+
+    std::vector<bool> used{};
+    base->assign(row_count, 0);
+    for (auto&& row : order) {
+      if (columns[row].empty()) {
+        continue;
+      }
+      std::size_t offset = 0;
+      for (;; ++offset) {
+        bool fit = true;
+        for (auto&& column : columns[row]) {
+          if (offset + column < used.size() && used[offset + column]) {
+            fit = false;
+            break;
+          }
+        }
+        if (fit) {
+          break;
+        }
+      }
+      (*base)[row] = offset;
+      for (auto&& column : columns[row]) {
+        if (used.size() <= offset + column) {
+          used.resize(offset + column + 1, false);
+        }
+        used[offset + column] = true;
+      }
+    }
+
+    // every base + column stays in the range, so the lookup needs no bound check.
+    std::size_t size = 0;
+    for (std::size_t row = 0; row < row_count; ++row) {
+      size = std::max(size, (*base)[row] + column_count);
+    }
+    check->assign(size, row_count);
+    value->assign(size, 0);
+    for (std::size_t row = 0; row < row_count; ++row) {
+      for (auto&& column : columns[row]) {
+        (*check)[(*base)[row] + column] = row;
+        (*value)[(*base)[row] + column] = dense[row * column_count + column];
+      }
+    }
+    return;
+  }
+
+  static std::size_t uint_size_for(std::size_t max) {
+    if (max <= 0xFF) {
+      return 1;
+    } else if (max <= 0xFFFF) {
+      return 2;
+    } else {
+      return 4;
+    }
+  }
+
+  // the tables for codegen_backend::table.
+  //   the entry for (nonterm, class of the lookahead) is 0 on the error, else the number
+  //   of the action plus 1; it is ryx_ll1_table[nonterm * RYX_CLASS_COUNT + class]
+  //   in the dense layout, and ryx_ll1_value[ryx_ll1_base[nonterm] + class] if
+  //   ryx_ll1_check agrees in the comb layout.
+  //   the action a pushes ryx_action_rhs[ryx_action_rhs_begin[a] .. ryx_action_rhs_begin[a + 1]]
+  //   in the order, with <end-of-body> ahead if the nonterm makes a node, then the
+  //   lookahead itself if ryx_action_push_lookahead[a]; the nonterm stays under them
+  //   if ryx_action_loop[a].
+  void emit_parse_table(void) {
+    std::size_t nonterm_count = enum_id_to_token_id.size() - enum_id_nts_base;
+
+    std::vector<std::size_t> ll1_table(nonterm_count * class_count, 0);
+    std::vector<std::size_t> transparent(nonterm_count, 0);
+    std::vector<std::size_t> lexeme(nonterm_count, 0);
+    for (std::size_t row = 0; row < nonterm_count; ++row) {
+      if (is_generated(enum_id_to_token_id[enum_id_nts_base + row])) {
+        transparent[row] = 1;
+      }
+      if (is_lexeme(enum_id_to_token_id[enum_id_nts_base + row])) {
+        lexeme[row] = 1;
+      }
+      for (std::size_t cls = 0; cls < class_count; ++cls) {
+        if (action_table[row][cls] != no_action) {
+          ll1_table[row * class_count + cls] = action_table[row][cls] + 1;
+        }
+      }
+    }
+
+    std::vector<std::size_t> rhs_begin{};
+    std::vector<std::size_t> push_lookahead{};
+    std::vector<std::size_t> loop{};
+    std::vector<std::vector<std::size_t>> rhs(actions.size());
+    std::size_t rhs_size = 0;
+    for (std::size_t aid = 0; aid < actions.size(); ++aid) {
+      auto&& symbols = action_symbols(actions[aid]);
+      if (!symbols.empty() || actions[aid].leads_with_lookahead) {
+        if (!is_generated(rules.head(actions[aid].rid))) {
+          rhs[aid].push_back(token_id_to_enum_id[special_token]);
+        }
+      }
+      for (auto&& it = symbols.rbegin(); it != symbols.rend(); ++it) {
+        if (is_repeat(*it)) {
+          rhs[aid].push_back(0);
+        }
+        rhs[aid].push_back(token_id_to_enum_id[*it]);
+      }
+      rhs_begin.push_back(rhs_size);
+      rhs_size += rhs[aid].size();
+      push_lookahead.push_back(actions[aid].leads_with_lookahead ? 1 : 0);
+      loop.push_back(actions[aid].loops ? 1 : 0);
+    }
+    rhs_begin.push_back(rhs_size);
+
+    ccfile << "#define RYX_NONTERM_BASE " + std::to_string(enum_id_nts_base)
+           << "#define RYX_NONTERM_COUNT " + std::to_string(nonterm_count)
+           << "";
+
+    std::vector<std::size_t> base{}, check{}, value{};
+    pack_comb(ll1_table, nonterm_count, class_count, &base, &check, &value);
+    std::size_t dense_bytes = ll1_table.size() * uint_size_for(actions.size());
+    std::size_t comb_bytes = base.size() * uint_size_for(check.size())
+                           + check.size() * uint_size_for(nonterm_count)
+                           + value.size() * uint_size_for(actions.size());
+    switch (options.table_layout) {
+      case codegen_table_layout::automatic:
+        comb_table = comb_bytes < dense_bytes;
+        break;
+      case codegen_table_layout::dense:
+        comb_table = false;
+        break;
+      case codegen_table_layout::comb:
+        comb_table = true;
+        break;
+    }
+
+    if (comb_table) {
+      ccfile << "// the comb layout of the LL(1) table; "
+                + std::to_string(comb_bytes) + " bytes instead of "
+                + std::to_string(dense_bytes) + "."
+             << "";
+
+      ccfile << "INTERN"
+             << "const " + uint_type_for(check.size()) + " ryx_ll1_base[RYX_NONTERM_COUNT] = {";
+      emit_array_values(base);
+      ccfile << "};"
+             << "INTERN_END"
+             << "";
+
+      ccfile << "INTERN"
+             << "const " + uint_type_for(nonterm_count) + " ryx_ll1_check[" + std::to_string(check.size()) + "] = {";
+      emit_array_values(check);
+      ccfile << "};"
+             << "INTERN_END"
+             << "";
+
+      ccfile << "INTERN"
+             << "const " + uint_type_for(actions.size()) + " ryx_ll1_value[" + std::to_string(value.size()) + "] = {";
+      emit_array_values(value);
+      ccfile << "};"
+             << "INTERN_END"
+             << "";
+    } else {
+      ccfile << "INTERN"
+             << "const " + uint_type_for(actions.size()) + " ryx_ll1_table[RYX_NONTERM_COUNT * RYX_CLASS_COUNT] = {";
+      for (std::size_t row = 0; row < nonterm_count; ++row) {
+        ccfile << "  // " + id_to_token.at(enum_id_to_token_id[enum_id_nts_base + row]);
+        emit_array_values(std::vector<std::size_t>(ll1_table.begin() + static_cast<std::ptrdiff_t>(row * class_count),
+                                                   ll1_table.begin() + static_cast<std::ptrdiff_t>((row + 1) * class_count)));
+      }
+      ccfile << "};"
+             << "INTERN_END"
+             << "";
+    }
+
+    ccfile << "INTERN"
+           << "const uint8_t ryx_nonterm_transparent[RYX_NONTERM_COUNT] = {";
+    emit_array_values(transparent);
+    ccfile << "};"
+           << "INTERN_END"
+           << "";
+
+    // the counts a repetition takes; a max of 0 is no repetition.
+    if (!repeats.empty()) {
+      std::vector<std::size_t> repeat_min(nonterm_count, 0);
+      std::vector<std::size_t> repeat_max(nonterm_count, 0);
+      for (auto&& it = repeats.begin(); it != repeats.end(); ++it) {
+        repeat_min[token_id_to_enum_id[it->first] - enum_id_nts_base] = it->second.first;
+        repeat_max[token_id_to_enum_id[it->first] - enum_id_nts_base] = it->second.second;
+      }
+      std::size_t max_count = *std::max_element(repeat_max.begin(), repeat_max.end());
+      ccfile << "INTERN"
+             << "const " + uint_type_for(max_count) + " ryx_nonterm_repeat_min[RYX_NONTERM_COUNT] = {";
+      emit_array_values(repeat_min);
+      ccfile << "};"
+             << "INTERN_END"
+             << "";
+
+      ccfile << "INTERN"
+             << "const " + uint_type_for(max_count) + " ryx_nonterm_repeat_max[RYX_NONTERM_COUNT] = {";
+      emit_array_values(repeat_max);
+      ccfile << "};"
+             << "INTERN_END"
+             << "";
+    }
+
+    if (options.leaves) {
+      ccfile << "INTERN"
+             << "const uint8_t ryx_nonterm_lexeme[RYX_NONTERM_COUNT] = {";
+      emit_array_values(lexeme);
+      ccfile << "};"
+             << "INTERN_END"
+             << "";
+    }
+
+    // the first state of the scanner of the nonterm, or 0.
+    if (!scanner_start.empty()) {
+      std::vector<std::size_t> dfa(nonterm_count, 0);
+      for (auto&& it = scanner_start.begin(); it != scanner_start.end(); ++it) {
+        dfa[token_id_to_enum_id[it->first] - enum_id_nts_base] = scanner_value(it->second + scanner_first_state);
+      }
+      ccfile << "INTERN"
+             << "const " + uint_type_for(scanner_value(scanner_next.size() + scanner_first_state))
+                + " ryx_nonterm_dfa[RYX_NONTERM_COUNT] = {";
+      emit_array_values(dfa);
+      ccfile << "};"
+             << "INTERN_END"
+             << "";
+    }
+
+    ccfile << "INTERN"
+           << "const " + uint_type_for(rhs_size) + " ryx_action_rhs_begin[" + std::to_string(actions.size() + 1) + "] = {";
+    emit_array_values(rhs_begin);
+    ccfile << "};"
+           << "INTERN_END"
+           << "";
+
+    ccfile << "INTERN"
+           << "const uint8_t ryx_action_push_lookahead[" + std::to_string(actions.size() + 1) + "] = {";
+    emit_array_values(push_lookahead);
+    ccfile << "  0,"
+           << "};"
+           << "INTERN_END"
+           << "";
+
+    ccfile << "INTERN"
+           << "const uint8_t ryx_action_loop[" + std::to_string(actions.size() + 1) + "] = {";
+    emit_array_values(loop);
+    ccfile << "  0,"
+           << "};"
+           << "INTERN_END"
+           << "";
+
+    ccfile << "INTERN"
+           << "const " + uint_type_for(enum_id_to_token_id.size()) + " ryx_action_rhs[" + std::to_string(rhs_size + 1) + "] = {";
+    for (std::size_t aid = 0; aid < actions.size(); ++aid) {
+      if (rhs[aid].size() == 0) {
+        continue;
+      }
+      ccfile << "  // " + action_description(actions[aid]);
+      emit_array_values(rhs[aid]);
+    }
+    // keeps the array non-empty.
+    ccfile << "  0,"
+           << "};"
+           << "INTERN_END"
+           << "";
+
+    return;
+  }
+
+  // the input terminals, the character classes and the literals.
+  bool is_terminal(token_id tid) {
+    return token_id_to_enum_id.at(tid) < enum_id_nts_base;
+  }
+
+  bool is_literal(token_id tid) {
+    return literals.find(tid) != literals.end();
+  }
+
+  // a repetition keeps its count just below it on the stack.
+  bool is_repeat(token_id tid) {
+    return repeats.find(tid) != repeats.end();
+  }
+
+  std::size_t repeat_count_of(const std::vector<token_id>& symbols) {
+    return static_cast<std::size_t>(std::count_if(symbols.begin(), symbols.end(),
+                                                  [&](token_id tid) { return is_repeat(tid); }));
+  }
+
+  // the symbols the action pushes, except <end-of-body> and the lookahead.
+  std::vector<token_id> action_symbols(const parse_action& action) {
+    auto&& body = rules.body(action.rid);
+    auto&& first = body.begin() + (action.leads_with_lookahead ? 1 : 0);
+    auto&& last = body.end() - (action.loops ? 1 : 0);
+    if (first >= last) {
+      return std::vector<token_id>{};
+    } else {
+      return std::vector<token_id>(first, last);
+    }
+  }
+
+  std::string action_description(const parse_action& action) {
+    std::string ret = id_to_token.at(rules.head(action.rid)) + " ->";
+    if (action.leads_with_lookahead) {
+      ret += " (lookahead)";
+    } else if (rules.body(action.rid).size() == 0) {
+      ret += " (empty)";
+    }
+    auto&& symbols = action_symbols(action);
+    for (auto&& it = symbols.begin(); it != symbols.end(); ++it) {
+      ret += " " + id_to_token.at(*it);
+    }
+    if (action.loops) {
+      ret += " (loop)";
+    }
+    return ret;
+  }
+
+  // builds the actions, and groups the terminals by their columns of the action table.
+  // a rule leading with a terminal only applies on that very lookahead, so it is
+  // recorded as "push the rest, then the lookahead"; the rules a character class
+  // expands to then collapse to one action, and the bytes of the class to one column.
+  // a literal is more than its lookahead, and stays on the stack.
+  void build_term_classes(void) {
+    std::size_t term_count = enum_id_charsets_base;
+    std::size_t nonterm_count = enum_id_to_token_id.size() - enum_id_nts_base;
+    rule_id empty_rule_id = rules.size();
+
+    std::map<std::vector<std::size_t>, std::size_t> key_to_action{};
+    std::vector<std::size_t> rule_to_action(rules.size(), no_action);
+    auto&& action_of = [&](rule_id rid) {
+      if (rule_to_action[rid] != no_action) {
+        return rule_to_action[rid];
+      }
+      token_id head = rules.head(rid);
+      auto&& body = rules.body(rid);
+      parse_action action{rid, false, false};
+      if (body.size() != 0 && body.back() == head && is_generated(head)) {
+        action.loops = true;
+      }
+      std::vector<std::size_t> key{0, rid};
+      if (body.size() != 0 && is_terminal(body.front()) && !is_literal(body.front())) {
+        action.leads_with_lookahead = true;
+        key = std::vector<std::size_t>{1, head};
+        key.insert(key.end(), body.begin() + 1, body.end());
+      }
+      auto&& it = key_to_action.find(key);
+      if (it == key_to_action.end()) {
+        it = key_to_action.insert(std::make_pair(key, actions.size())).first;
+        actions.push_back(action);
+      }
+      rule_to_action[rid] = it->second;
+      return it->second;
+    };
+
+    std::vector<std::vector<std::size_t>> columns(term_count,
+                                                  std::vector<std::size_t>(nonterm_count, no_action));
+    // the character classes and the literals have columns of their own, which stay empty.
+    std::vector<enum_id> column_to_enum_id{};
+    for (auto&& it = table.terms.begin(); it != table.terms.end(); ++it) {
+      auto&& eid = token_id_to_enum_id.find(*it);
+      column_to_enum_id.push_back(eid == token_id_to_enum_id.end() ? term_count : eid->second);
+    }
+    for (std::size_t row = 0; row < nonterm_count; ++row) {
+      token_id nts_tid = enum_id_to_token_id[enum_id_nts_base + row];
+      if (!table.has_row(nts_tid)) {
+        continue;
+      } else if (nts_tid == first_nonterm) {
+        continue;
+      } else if (nts_tid == atmark) {
+        continue;
+      }
+      std::size_t table_row = table.row(nts_tid);
+      for (std::size_t column = 0; column < table.terms.size(); ++column) {
+        rule_id rid = table.cell(table_row, column);
+        if (rid >= empty_rule_id) {
+          continue;
+        }
+        columns[column_to_enum_id[column]][row] = action_of(rid);
+      }
+    }
+
+    std::map<std::vector<std::size_t>, std::size_t> column_to_class{};
+    term_class.assign(term_count, 0);
+    action_table.assign(nonterm_count, std::vector<std::size_t>{});
+    for (enum_id ts_eid = 0; ts_eid < term_count; ++ts_eid) {
+      auto&& it = column_to_class.find(columns[ts_eid]);
+      if (it == column_to_class.end()) {
+        it = column_to_class.insert(std::make_pair(columns[ts_eid], column_to_class.size())).first;
+        for (std::size_t row = 0; row < nonterm_count; ++row) {
+          action_table[row].push_back(columns[ts_eid][row]);
+        }
+      }
+      term_class[ts_eid] = it->second;
+    }
+    class_count = column_to_class.size();
+
+    return;
+  }
+
+  // runs the prediction stack of a lexeme on the lookahead as the parser does; the stack
+  // either takes it (scanner_first_state), empties before it, or rejects it. a literal
+  // on the top is spelled out as its bytes, and a repetition counts below it as in the parser.
+  // the lookahead is the enum id of a terminal, or enum_id_charsets_base for the others.
+  std::size_t scanner_step(std::vector<token_id>* stack,
+                           enum_id lookahead,
+                           const std::vector<int>& byte_of) {
+    while (!stack->empty()) {
+      token_id top = stack->back();
+      if (lookahead == enum_id_charsets_base) {
+        return scanner_error;
+      }
+      token_id lookahead_tid = enum_id_to_token_id[lookahead];
+      auto&& repeat = repeats.find(top);
+      if (is_literal(top)) {
+        auto&& bytes = literals.at(top);
+        stack->pop_back();
+        for (auto&& it = bytes.rbegin(); it != bytes.rend(); ++it) {
+          stack->push_back(enum_id_to_token_id[byte_to_enum_id.at(static_cast<unsigned char>(*it))]);
+        }
+      } else if (repeat != repeats.end() && (*stack)[stack->size() - 2] == repeat->second.second) {
+        stack->resize(stack->size() - 2);
+      } else if (!is_terminal(top)) {
+        rule_id rid = table.at(top, lookahead_tid);
+        if (rid >= rules.size()) {
+          return scanner_error;
+        }
+        auto&& body = rules.body(rid);
+        if (repeat != repeats.end() && body.size() != 0) {
+          // the count takes the place of the loop.
+          (*stack)[stack->size() - 2] += 1;
+          stack->pop_back();
+        } else if (repeat != repeats.end()) {
+          if ((*stack)[stack->size() - 2] < repeat->second.first) {
+            return scanner_error;
+          }
+          stack->resize(stack->size() - 2);
+        } else {
+          stack->pop_back();
+        }
+        for (auto&& sym = body.rbegin(); sym != body.rend(); ++sym) {
+          if (is_repeat(*sym) && *sym != top) {
+            stack->push_back(0);
+          }
+          stack->push_back(*sym);
+        }
+      } else if (top == lookahead_tid
+                 || (classes.find(top) != classes.end()
+                     && byte_of[lookahead] >= 0
+                     && classes.at(top)[static_cast<std::size_t>(byte_of[lookahead])])) {
+        stack->pop_back();
+        return scanner_first_state;
+      } else {
+        return scanner_error;
+      }
+    }
+    return scanner_done;
+  }
+
+  // the states are the contents of the prediction stack above the lexeme; a lexeme whose
+  // stack grows past the rules it reaches nests, and is not regular.
+  bool build_scanner(token_id lexeme,
+                     const std::vector<int>& byte_of,
+                     std::vector<std::vector<std::size_t>>* dfa) {
+    const std::size_t max_states = 4096;
+    std::size_t max_depth = 1;
+    std::unordered_set<token_id> reached{lexeme};
+    std::vector<token_id> queue{lexeme};
+    while (!queue.empty()) {
+      token_id nts_tid = queue.back();
+      queue.pop_back();
+      for (rule_id rid = 0; rid < rules.size(); ++rid) {
+        if (rules.head(rid) != nts_tid) {
+          continue;
+        }
+        max_depth += rules.body(rid).size();
+        for (auto&& symbol : rules.body(rid)) {
+          if (is_literal(symbol)) {
+            max_depth += literals.at(symbol).size() - 1;
+          } else if (!is_terminal(symbol) && reached.insert(symbol).second) {
+            queue.push_back(symbol);
+          }
+          if (is_repeat(symbol)) {
+            max_depth += 1;
+          }
+        }
+      }
+    }
+
+    std::map<std::vector<token_id>, std::size_t> state_of{};
+    std::vector<std::vector<token_id>> states{};
+    states.push_back(std::vector<token_id>{lexeme});
+    state_of[states.back()] = 0;
+    for (std::size_t state = 0; state < states.size(); ++state) {
+      std::vector<std::size_t> row(enum_id_charsets_base + 1);
+      for (enum_id lookahead = 0; lookahead <= enum_id_charsets_base; ++lookahead) {
+        std::vector<token_id> stack = states[state];
+        row[lookahead] = scanner_step(&stack, lookahead, byte_of);
+        if (row[lookahead] != scanner_first_state) {
+          continue;
+        }
+        auto&& it = state_of.find(stack);
+        if (it == state_of.end()) {
+          if (stack.size() > max_depth || states.size() == max_states) {
+            return false;
+          }
+          it = state_of.insert(std::make_pair(stack, states.size())).first;
+          states.push_back(stack);
+        }
+        row[lookahead] = it->second + scanner_first_state;
+      }
+      dfa->push_back(std::move(row));
+    }
+    return true;
+  }
+
+  // merges the states no input tells apart, as Moore does; the start state stays first.
+  static void minimize_scanner(std::vector<std::vector<std::size_t>>* dfa) {
+    std::vector<std::size_t> block(dfa->size(), 0);
+    std::size_t block_count = 1;
+    while (true) {
+      std::map<std::vector<std::size_t>, std::size_t> block_of{};
+      std::vector<std::size_t> next_block(dfa->size());
+      for (std::size_t state = 0; state < dfa->size(); ++state) {
+        std::vector<std::size_t> key{block[state]};
+        for (auto&& next : (*dfa)[state]) {
+          key.push_back(next < scanner_first_state ? next : block[next - scanner_first_state] + scanner_first_state);
+        }
+        next_block[state] = block_of.insert(std::make_pair(key, block_of.size())).first->second;
+      }
+      block = std::move(next_block);
+      if (block_of.size() == block_count) {
+        break;
+      }
+      block_count = block_of.size();
+    }
+
+    std::vector<std::vector<std::size_t>> minimized(block_count);
+    for (std::size_t state = 0; state < dfa->size(); ++state) {
+      if (!minimized[block[state]].empty()) {
+        continue;
+      }
+      for (auto&& next : (*dfa)[state]) {
+        minimized[block[state]].push_back(next < scanner_first_state ? next : block[next - scanner_first_state] + scanner_first_state);
+      }
+    }
+    *dfa = std::move(minimized);
+    return;
+  }
+
+  void build_scanners(void) {
+    std::vector<int> byte_of(enum_id_charsets_base + 1, -1);
+    for (auto&& it = byte_to_enum_id.begin(); it != byte_to_enum_id.end(); ++it) {
+      byte_of[it->second] = it->first;
+    }
+
+    for (enum_id nts_eid = enum_id_nts_base; nts_eid < enum_id_to_token_id.size(); ++nts_eid) {
+      token_id nts_tid = enum_id_to_token_id[nts_eid];
+      if (!is_lexeme(nts_tid)) {
+        continue;
+      }
+      std::vector<std::vector<std::size_t>> dfa{};
+      if (!build_scanner(nts_tid, byte_of, &dfa)) {
+        continue;
+      }
+      minimize_scanner(&dfa);
+      std::size_t base = scanner_next.size();
+      scanner_start[nts_tid] = base;
+      for (auto&& row : dfa) {
+        for (auto&& next : row) {
+          if (next >= scanner_first_state) {
+            next += base;
+          }
+        }
+        scanner_next.push_back(std::move(row));
+      }
+    }
+
+    // the terminals no state tells apart share a class.
+    std::map<std::vector<std::size_t>, std::size_t> column_to_class{};
+    std::vector<std::vector<std::size_t>> rows(scanner_next.size());
+    scanner_class.assign(enum_id_charsets_base + 1, 0);
+    for (enum_id lookahead = 0; lookahead <= enum_id_charsets_base; ++lookahead) {
+      std::vector<std::size_t> column{};
+      for (auto&& row : scanner_next) {
+        column.push_back(row[lookahead]);
+      }
+      auto&& it = column_to_class.find(column);
+      if (it == column_to_class.end()) {
+        it = column_to_class.insert(std::make_pair(column, column_to_class.size())).first;
+        for (std::size_t state = 0; state < scanner_next.size(); ++state) {
+          rows[state].push_back(column[state]);
+        }
+      }
+      scanner_class[lookahead] = it->second;
+    }
+    scanner_next = std::move(rows);
+    scanner_class_count = column_to_class.size();
+
+    build_scanner_runs();
+
+    // the nonterms only a scanner reaches need no case.
+    std::vector<token_id> queue{first_nonterm};
+    stacked_nonterms.insert(first_nonterm);
+    while (!queue.empty()) {
+      token_id nts_tid = queue.back();
+      queue.pop_back();
+      if (scanner_start.find(nts_tid) != scanner_start.end()) {
+        continue;
+      }
+      for (rule_id rid = 0; rid < rules.size(); ++rid) {
+        if (rules.head(rid) != nts_tid) {
+          continue;
+        }
+        for (auto&& symbol : rules.body(rid)) {
+          if (!is_terminal(symbol) && stacked_nonterms.insert(symbol).second) {
+            queue.push_back(symbol);
+          }
+        }
+      }
+    }
+
+    return;
+  }
+
+  // the class of each byte of a buffer; the bytes no terminal names fall in the last.
+  std::vector<std::size_t> scanner_byte_class(void) {
+    std::vector<std::size_t> ret(256, scanner_class[enum_id_charsets_base]);
+    for (auto&& it = byte_to_enum_id.begin(); it != byte_to_enum_id.end(); ++it) {
+      ret[static_cast<std::size_t>(it->first)] = scanner_class[it->second];
+    }
+    return ret;
+  }
+
+  // the ranges of the bytes in the set.
+  static std::vector<std::pair<int, int>> byte_ranges(const std::vector<bool>& bytes) {
+    std::vector<std::pair<int, int>> ret{};
+    for (int c = 0; c < 256; ++c) {
+      if (!bytes[static_cast<std::size_t>(c)]) {
+        continue;
+      } else if (!ret.empty() && ret.back().second == c - 1) {
+        ret.back().second = c;
+      } else {
+        ret.push_back(std::make_pair(c, c));
+      }
+    }
+    return ret;
+  }
+
+  // the states that loop on a few ranges of bytes get a run; SSE2 tests 16 bytes per
+  // range at a time, so the runs with more ranges are left to the table.
+  void build_scanner_runs(void) {
+    const std::size_t max_ranges = 4;
+    std::vector<std::size_t> byte_class = scanner_byte_class();
+    std::map<std::pair<bool, std::vector<std::pair<int, int>>>, std::size_t> run_index{};
+    scanner_run.assign(scanner_next.size(), 0);
+    for (std::size_t state = 0; state < scanner_next.size(); ++state) {
+      std::vector<bool> stays(256), stops(256);
+      bool loops = false;
+      for (std::size_t c = 0; c < 256; ++c) {
+        stays[c] = scanner_next[state][byte_class[c]] == state + scanner_first_state;
+        stops[c] = !stays[c];
+        loops = loops || stays[c];
+      }
+      if (!loops) {
+        continue;
+      }
+      byte_run run{byte_ranges(stays), false};
+      std::vector<std::pair<int, int>> stop_ranges = byte_ranges(stops);
+      if (stop_ranges.size() <= run.ranges.size()) {
+        run.ranges = std::move(stop_ranges);
+        run.stops = true;
+      }
+      if (run.ranges.size() > max_ranges) {
+        continue;
+      }
+      auto&& it = run_index.find(std::make_pair(run.stops, run.ranges));
+      if (it == run_index.end()) {
+        it = run_index.insert(std::make_pair(std::make_pair(run.stops, run.ranges), scanner_runs.size() + 1)).first;
+        scanner_runs.push_back(run);
+      }
+      scanner_run[state] = it->second;
+    }
+    return;
+  }
+
+  // a state as the generated tables hold it: the offset of its row, which saves the
+  // scanner a multiplication per byte.
+  std::size_t scanner_value(std::size_t next) {
+    if (next < scanner_first_state) {
+      return next;
+    } else {
+      return next * scanner_class_count;
+    }
+  }
+
+  // the first few members of the class, for comments.
+  std::string class_description(std::size_t cls) {
+    std::string ret{};
+    std::size_t members = 0;
+    for (enum_id ts_eid = 0; ts_eid < term_class.size(); ++ts_eid) {
+      if (term_class[ts_eid] != cls) {
+        continue;
+      }
+      if (members == 4) {
+        ret += " ...";
+        break;
+      }
+      ret += " " + id_to_token.at(enum_id_to_token_id[ts_eid]);
+      members += 1;
+    }
+    return ret;
+  }
+
+  // a bit per terminal kind for each character class.
+  void emit_charsets(void) {
+    std::size_t term_count = enum_id_charsets_base;
+    std::size_t mask_bytes = (term_count + 7) / 8;
+    std::vector<std::size_t> masks{};
+    for (enum_id eid = enum_id_charsets_base; eid < enum_id_literals_base; ++eid) {
+      auto&& chars = classes.at(enum_id_to_token_id[eid]);
+      std::vector<std::size_t> mask(mask_bytes, 0);
+      for (int c = 0; c < 256; ++c) {
+        if (chars[static_cast<std::size_t>(c)]) {
+          enum_id byte_eid = byte_to_enum_id.at(c);
+          mask[byte_eid / 8] |= std::size_t{1} << (byte_eid % 8);
+        }
+      }
+      masks.insert(masks.end(), mask.begin(), mask.end());
+    }
+
+    ccfile << "#define RYX_CHARSET_BASE " + std::to_string(enum_id_charsets_base)
+           << "#define RYX_CHARSET_MASK_BYTES " + std::to_string(mask_bytes)
+           << "";
+
+    ccfile << "INTERN"
+           << "const uint8_t ryx_charset_masks["
+              + std::to_string(enum_id_literals_base - enum_id_charsets_base)
+              + " * RYX_CHARSET_MASK_BYTES] = {";
+    for (enum_id eid = enum_id_charsets_base; eid < enum_id_literals_base; ++eid) {
+      std::size_t offset = (eid - enum_id_charsets_base) * mask_bytes;
+      ccfile << "  // " + id_to_token.at(enum_id_to_token_id[eid]);
+      emit_array_values(std::vector<std::size_t>(masks.begin() + static_cast<std::ptrdiff_t>(offset),
+                                                 masks.begin() + static_cast<std::ptrdiff_t>(offset + mask_bytes)));
+    }
+    ccfile << "};"
+           << "INTERN_END"
+           << "";
+
+    // top is a terminal or a character class; kind comes from the input.
+    ccfile << "INTERN"
+           << "int ryx_charset_match(enum ryx_node_kind top, enum ryx_node_kind kind) {"
+           << "  size_t offset;"
+           << ""
+           << "  if (CAST(size_t, top) < RYX_CHARSET_BASE || CAST(size_t, kind) >= RYX_TERM_COUNT) {"
+           << "    return 0;"
+           << "  }"
+           << ""
+           << "  offset = (CAST(size_t, top) - RYX_CHARSET_BASE) * RYX_CHARSET_MASK_BYTES;"
+           << "  return (ryx_charset_masks[offset + CAST(size_t, kind) / 8] >> (CAST(size_t, kind) % 8)) & 1;"
+           << "}"
+           << "INTERN_END"
+           << "";
+
+    return;
+  }
+
+  void emit_term_classes(void) {
+    ccfile << "#define RYX_TERM_COUNT " + std::to_string(term_class.size())
+           << "#define RYX_CLASS_COUNT " + std::to_string(class_count)
+           << "";
+
+    ccfile << "INTERN"
+           << "const " + uint_type_for(class_count) + " ryx_term_class[RYX_TERM_COUNT] = {";
+    emit_array_values(term_class);
+    ccfile << "};"
+           << "INTERN_END"
+           << "";
+
+    if (!classes.empty()) {
+      emit_charsets();
+    }
+
+    // RYX_CLASS_COUNT for the kinds out of the terminals; no action accepts it.
+    ccfile << "INTERN"
+           << "size_t ryx_class_of(enum ryx_node_kind kind) {"
+           << "  if (CAST(size_t, kind) < RYX_TERM_COUNT) {"
+           << "    return ryx_term_class[kind];"
+           << "  } else {"
+           << "    return RYX_CLASS_COUNT;"
+           << "  }"
+           << "}"
+           << "INTERN_END"
+           << "";
+
+    return;
+  }
+
+  // the classes of the lookaheads on which :ws*: -> :ws: :ws*: and :ws: -> the lookahead,
+  // so that skipping them is what the table would have done.
+  void build_trivia_classes(void) {
+    auto&& is_rule = [&](token_id nts_tid, token_id lookahead, const std::vector<token_id>& body) {
+      rule_id rid = table.at(nts_tid, lookahead);
+      if (rid >= rules.size()) {
+        return false;
+      }
+      auto&& rule_body = rules.body(rid);
+      if (rule_body.size() != body.size()) {
+        return false;
+      }
+      for (std::size_t i = 0; i < body.size(); ++i) {
+        // a character class on the right matches the lookahead the table chose it for.
+        if (rule_body[i] != body[i] && (!is_terminal(body[i]) || classes.find(rule_body[i]) == classes.end())) {
+          return false;
+        }
+      }
+      return true;
+    };
+
+    auto&& skipped = [&](enum_id ts_eid) {
+      token_id lookahead = enum_id_to_token_id[ts_eid];
+      rule_id rid = table.at(spaces, lookahead);
+      if (rid >= rules.size()) {
+        return false;
+      }
+      auto&& body = rules.body(rid);
+      return body.size() == 2 && body[1] == spaces && !is_terminal(body[0])
+             && is_rule(body[0], lookahead, std::vector<token_id>{lookahead});
+    };
+
+    // :ws*: -> (empty) on the lookahead.
+    auto&& ends = [&](enum_id ts_eid) {
+      token_id lookahead = enum_id_to_token_id[ts_eid];
+      rule_id rid = table.at(spaces, lookahead);
+      return rid < rules.size() && rules.body(rid).empty();
+    };
+
+    std::map<std::size_t, bool> class_skipped{};
+    std::map<std::size_t, bool> class_ends{};
+    for (enum_id ts_eid = 0; ts_eid < term_class.size(); ++ts_eid) {
+      bool skip = skipped(ts_eid);
+      auto&& it = class_skipped.find(term_class[ts_eid]);
+      if (it == class_skipped.end()) {
+        class_skipped[term_class[ts_eid]] = skip;
+      } else {
+        it->second = it->second && skip;
+      }
+      bool end = ends(ts_eid);
+      auto&& jt = class_ends.find(term_class[ts_eid]);
+      if (jt == class_ends.end()) {
+        class_ends[term_class[ts_eid]] = end;
+      } else {
+        jt->second = jt->second && end;
+      }
+    }
+    for (auto&& it = class_skipped.begin(); it != class_skipped.end(); ++it) {
+      if (it->second) {
+        trivia_classes.insert(it->first);
+      }
+    }
+    for (auto&& it = class_ends.begin(); it != class_ends.end(); ++it) {
+      if (it->second) {
+        trivia_end_classes.insert(it->first);
+      }
+    }
+    return;
+  }
+
+  // a byte for the comments of the runs.
+  static std::string byte_description(int c) {
+    const char* hex = "0123456789abcdef";
+    if (c > ' ' && c < 0x7F && c != '\\') {
+      return std::string(1, static_cast<char>(c));
+    }
+    return std::string("\\x") + hex[c / 16] + hex[c % 16];
+  }
+
+  // a byte as the argument of _mm_set1_epi8.
+  static std::string sse_byte(int c) {
+    return "_mm_set1_epi8(CAST(char, " + std::to_string(c < 0x80 ? c : c - 0x100) + "))";
+  }
+
+  // the lanes of bytes that fall in the range; a range takes one unsigned compare,
+  // made of a signed one by moving lo to -128.
+  static std::string sse_range_test(const std::pair<int, int>& range) {
+    if (range.first == range.second) {
+      return "_mm_cmpeq_epi8(bytes, " + sse_byte(range.first) + ")";
+    }
+    return "_mm_cmplt_epi8(_mm_add_epi8(bytes, " + sse_byte((0x80 - range.first) & 0xFF) + "), "
+           + sse_byte((0x80 + range.second - range.first + 1) & 0xFF) + ")";
+  }
+
+  // ryx_dfa_run and ryx_dfa_skip; a run that stops at one byte takes memchr, the others
+  // take SSE2 where there is, and leave the bytes to ryx_dfa_scan where there is not.
+  void emit_scanner_runs(void) {
+    ccfile << "INTERN"
+           << "const " + uint_type_for(scanner_runs.size()) + " ryx_dfa_run[" + std::to_string(scanner_next.size()) + "] = {";
+    emit_array_values(scanner_run);
+    ccfile << "};"
+           << "INTERN_END"
+           << "";
+
+    bool uses_memchr = false;
+    bool uses_sse = false;
+    for (auto&& run : scanner_runs) {
+      if (run.stops && run.ranges.size() == 1 && run.ranges[0].first == run.ranges[0].second) {
+        uses_memchr = true;
+      } else if (!run.ranges.empty()) {
+        uses_sse = true;
+      }
+    }
+
+    // returns the first byte from cursor on that leaves the state the run belongs to,
+    // or any byte before it; ryx_dfa_scan goes on from there.
+    ccfile << "INTERN"
+           << "const unsigned char* ryx_dfa_skip(size_t run, const unsigned char* cursor, const unsigned char* end) {";
+    if (uses_memchr) {
+      ccfile << "  const void* found;";
+    }
+    if (uses_sse) {
+      ccfile << "#if defined(__SSE2__)"
+             << "  __m128i bytes;"
+             << "  __m128i in;"
+             << "  int stops;"
+             << "#endif";
+    }
+    if (uses_memchr || uses_sse) {
+      ccfile << "";
+    }
+    ccfile << "  switch (run) {";
+    for (std::size_t i = 0; i < scanner_runs.size(); ++i) {
+      auto&& run = scanner_runs[i];
+      std::string description{};
+      for (auto&& range : run.ranges) {
+        description += byte_description(range.first);
+        if (range.first != range.second) {
+          description += "-" + byte_description(range.second);
+        }
+      }
+      ccfile << "    case " + std::to_string(i + 1) + ":"
+             << "      // " + std::string(run.stops ? "up to " : "") + "[" + description + "]";
+      if (run.stops && run.ranges.empty()) {
+        ccfile << "      return end;";
+        continue;
+      } else if (run.stops && run.ranges.size() == 1 && run.ranges[0].first == run.ranges[0].second) {
+        ccfile << "      found = memchr(cursor, " + std::to_string(run.ranges[0].first) + ", CAST(size_t, end - cursor));"
+               << "      return found == NULLPTR ? end : CAST(const unsigned char*, found);";
+        continue;
+      }
+      ccfile << "#if defined(__SSE2__)"
+             << "      while (end - cursor >= 16) {"
+             << "        bytes = _mm_loadu_si128(CAST(const __m128i*, CAST(const void*, cursor)));"
+             << "        in = " + sse_range_test(run.ranges[0]) + ";";
+      for (std::size_t j = 1; j < run.ranges.size(); ++j) {
+        ccfile << "        in = _mm_or_si128(in, " + sse_range_test(run.ranges[j]) + ");";
+      }
+      ccfile << "        stops = " + std::string(run.stops ? "_mm_movemask_epi8(in);" : "~_mm_movemask_epi8(in) & 0xFFFF;")
+             << "        if (stops != 0) {"
+             << "          return cursor + __builtin_ctz(CAST(unsigned int, stops));"
+             << "        }"
+             << "        cursor += 16;"
+             << "      }"
+             << "#endif"
+             << "      return cursor;";
+    }
+    ccfile << "    default:"
+           << "      return cursor;"
+           << "  }"
+           << "}"
+           << "INTERN_END"
+           << "";
+
+    return;
+  }
+
+  // 1 on the term classes in classes_, 0 on the others.
+  void emit_class_test(const std::string& name, const std::set<std::size_t>& classes_) {
+    ccfile << "INTERN"
+           << "int " + name + "(size_t term_class) {"
+           << "  switch (term_class) {";
+    for (auto&& cls : classes_) {
+      ccfile << "    case " + std::to_string(cls) + ":  //" + class_description(cls);
+    }
+    if (!classes_.empty()) {
+      ccfile << "      return 1;";
+    }
+    ccfile << "    default:"
+           << "      return 0;"
+           << "  }"
+           << "}"
+           << "INTERN_END"
+           << "";
+    return;
+  }
+
+  // ryx_is_trivia, ryx_ends_trivia and ryx_skip_trivia, which take :ws*: in place.
+  void emit_trivia(void) {
+    emit_class_test("ryx_is_trivia", trivia_classes);
+    emit_class_test("ryx_ends_trivia", trivia_end_classes);
+
+    // *token is the lookahead past the whitespace, or NULLPTR if the input runs dry first.
+    ccfile << "INTERN"
+           << "void ryx_skip_trivia(struct ryx_input* input, struct ryx_token** token, size_t* offset) {"
+           << "  struct ryx_token* t;"
+           << "  const unsigned char* cursor;"
+           << "  const unsigned char* end;"
+           << ""
+           << "  t = *token;"
+           << "  while (ryx_is_trivia(ryx_class_of(t->kind))) {"
+           << "    ryx_token_free(t);"
+           << "    if (input->cursor != NULLPTR) {"
+           << "      // the bytes of a buffer take no token each."
+           << "      cursor = input->cursor;"
+           << "      end = input->end;"
+           << "      while (cursor != end && ryx_is_trivia(ryx_class_of(ryx_byte_tokens[*cursor].kind))) {"
+           << "        cursor += 1;"
+           << "      }"
+           << "      input->offset += CAST(size_t, cursor - input->cursor);"
+           << "      input->cursor = cursor;"
+           << "    }"
+           << "    t = ryx_input_next(input, offset);"
+           << "    if (t == NULLPTR) {"
+           << "      break;"
+           << "    }"
+           << "  }"
+           << "  *token = t;"
+           << ""
+           << "  return;"
+           << "}"
+           << "INTERN_END"
+           << "";
+
+    return;
+  }
+
+  // the bytes of a literal as a C string.
+  static std::string c_string_of(const std::string& bytes) {
+    std::string ret = "\"";
+    for (auto&& it = bytes.begin(); it != bytes.end(); ++it) {
+      int c = static_cast<unsigned char>(*it);
+      if (0x20 <= c && c <= 0x7E && c != '"' && c != '\\' && c != '?') {
+        ret.push_back(static_cast<char>(c));
+      } else {
+        // three octal digits, so that the next character is not taken in.
+        ret.push_back('\\');
+        ret.push_back(static_cast<char>('0' + ((c >> 6) & 7)));
+        ret.push_back(static_cast<char>('0' + ((c >> 3) & 7)));
+        ret.push_back(static_cast<char>('0' + (c & 7)));
+      }
+    }
+    ret.push_back('"');
+    return ret;
+  }
+
+  // the bytes of the literals, ryx_literal_prefix, which compares them with a buffer in
+  // one go, and ryx_literal_scan, which takes them from the input.
+  void emit_literals(void) {
+    std::size_t literal_count = enum_id_nts_base - enum_id_literals_base;
+    std::vector<std::size_t> sizes{};
+    ccfile << "#define RYX_LITERAL_BASE " + std::to_string(enum_id_literals_base)
+           << "";
+
+    ccfile << "INTERN"
+           << "const char* const ryx_literal_text[" + std::to_string(literal_count) + "] = {";
+    for (enum_id eid = enum_id_literals_base; eid < enum_id_nts_base; ++eid) {
+      auto&& bytes = literals.at(enum_id_to_token_id[eid]);
+      ccfile << "  " + c_string_of(bytes) + ",";
+      sizes.push_back(bytes.size());
+    }
+    ccfile << "};"
+           << "INTERN_END"
+           << "";
+
+    ccfile << "INTERN"
+           << "const size_t ryx_literal_size[" + std::to_string(literal_count) + "] = {";
+    emit_array_values(sizes);
+    ccfile << "};"
+           << "INTERN_END"
+           << "";
+
+    if (options.events) {
+      // what ryx_on_terminal gets for a literal.
+      ccfile << "INTERN"
+             << "struct ryx_token ryx_literal_tokens[" + std::to_string(literal_count) + "] = {";
+      for (enum_id eid = enum_id_literals_base; eid < enum_id_nts_base; ++eid) {
+        ccfile << "  {" + token_id_to_enum_string[enum_id_to_token_id[eid]]
+                  + ", NULLPTR, ryx_free_static_token},";
+      }
+      ccfile << "};"
+             << "INTERN_END"
+             << "";
+    }
+
+    // how many of the n bytes of text the buffer begins with.
+    ccfile << "INTERN"
+           << "size_t ryx_literal_prefix(const unsigned char* cursor, const unsigned char* end,"
+           << "                          const char* text, size_t n) {"
+           << "  size_t i;"
+           << ""
+           << "  if (CAST(size_t, end - cursor) >= n && memcmp(cursor, text, n) == 0) {"
+           << "    return n;"
+           << "  }"
+           << "  i = 0;"
+           << "  while (i < n && cursor + i != end && cursor[i] == CAST(unsigned char, text[i])) {"
+           << "    i += 1;"
+           << "  }"
+           << ""
+           << "  return i;"
+           << "}"
+           << "INTERN_END"
+           << "";
+
+    // matches the literal kind on from its byte matched; *token is the lookahead.
+    // returns 0 on a byte that differs, with the byte in *token; the size of the literal
+    // once all of it is taken, with *offset on its last byte; or the bytes matched so far
+    // if the input runs dry. *token is NULLPTR but on the error.
+    ccfile << "INTERN"
+           << "size_t ryx_literal_scan(struct ryx_input* input, struct ryx_token** token, size_t* offset,"
+           << "                        enum ryx_node_kind kind, size_t matched) {"
+           << "  const char* text;"
+           << "  size_t size;"
+           << "  size_t n;"
+           << ""
+           << "  text = ryx_literal_text[CAST(size_t, kind) - RYX_LITERAL_BASE];"
+           << "  size = ryx_literal_size[CAST(size_t, kind) - RYX_LITERAL_BASE];"
+           << "  for (;;) {"
+           << "    if ((*token)->kind != ryx_byte_tokens[CAST(unsigned char, text[matched])].kind) {"
+           << "      return 0;"
+           << "    }"
+           << "    ryx_token_free(*token);"
+           << "    *token = NULLPTR;"
+           << "    matched += 1;"
+           << "    if (input->cursor != NULLPTR && matched != size) {"
+           << "      n = ryx_literal_prefix(input->cursor, input->end, text + matched, size - matched);"
+           << "      input->cursor += n;"
+           << "      input->offset += n;"
+           << "      *offset += n;"
+           << "      matched += n;"
+           << "    }"
+           << "    if (matched == size) {"
+           << "      return size;"
+           << "    }"
+           << "    *token = ryx_input_next(input, offset);"
+           << "    if (*token == NULLPTR) {"
+           << "      return matched;"
+           << "    }"
+           << "  }"
+           << "}"
+           << "INTERN_END"
+           << "";
+
+    return;
+  }
+
+  // the scanner tables and ryx_dfa_scan; a buffer runs through ryx_dfa_byte_class.
+  void emit_scanners(void) {
+    ccfile << "#define RYX_DFA_CLASS_COUNT " + std::to_string(scanner_class_count)
+           << "#define RYX_DFA_ERROR " + std::to_string(scanner_error)
+           << "#define RYX_DFA_DONE " + std::to_string(scanner_done)
+           << "#define RYX_DFA_FIRST_STATE " + std::to_string(scanner_first_state)
+           << "";
+
+    ccfile << "INTERN"
+           << "const " + uint_type_for(scanner_class_count) + " ryx_dfa_class[RYX_TERM_COUNT + 1] = {";
+    emit_array_values(scanner_class);
+    ccfile << "};"
+           << "INTERN_END"
+           << "";
+
+    ccfile << "INTERN"
+           << "const " + uint_type_for(scanner_class_count) + " ryx_dfa_byte_class[256] = {";
+    emit_array_values(scanner_byte_class());
+    ccfile << "};"
+           << "INTERN_END"
+           << "";
+
+    std::map<std::size_t, token_id> start_to_lexeme{};
+    for (auto&& it = scanner_start.begin(); it != scanner_start.end(); ++it) {
+      start_to_lexeme[it->second] = it->first;
+    }
+    ccfile << "INTERN"
+           << "const " + uint_type_for(scanner_value(scanner_next.size() + scanner_first_state))
+              + " ryx_dfa_next[" + std::to_string(scanner_next.size()) + " * RYX_DFA_CLASS_COUNT] = {";
+    for (std::size_t state = 0; state < scanner_next.size(); ++state) {
+      auto&& it = start_to_lexeme.find(state);
+      if (it != start_to_lexeme.end()) {
+        ccfile << "  // " + id_to_token.at(it->second);
+      }
+      std::vector<std::size_t> row{};
+      for (auto&& next : scanner_next[state]) {
+        row.push_back(scanner_value(next));
+      }
+      emit_array_values(row);
+    }
+    ccfile << "};"
+           << "INTERN_END"
+           << "";
+
+    // the states are the offsets of their rows, which start at RYX_DFA_FIRST_STATE rows.
+    ccfile << "#define RYX_DFA_ROW(dfa) (&ryx_dfa_next[(dfa) - RYX_DFA_FIRST_STATE * RYX_DFA_CLASS_COUNT])"
+           << "";
+
+    if (!scanner_runs.empty()) {
+      emit_scanner_runs();
+    }
+
+    // returns RYX_DFA_DONE with the lookahead past the lexeme, RYX_DFA_ERROR with the
+    // lookahead rejected, or the state with *token NULLPTR if the input runs dry first.
+    ccfile << "INTERN"
+           << "size_t ryx_dfa_scan(struct ryx_input* input, struct ryx_token** token, size_t* offset, size_t dfa) {"
+           << "  struct ryx_token* t;"
+           << "  const unsigned char* cursor;"
+           << "  const unsigned char* end;"
+           << "  size_t kind;"
+           << "  size_t next;";
+    if (!scanner_runs.empty()) {
+      ccfile << "  size_t run;";
+    }
+    ccfile << ""
+           << "  t = *token;"
+           << "  for (;;) {"
+           << "    kind = CAST(size_t, t->kind);"
+           << "    next = RYX_DFA_ROW(dfa)[ryx_dfa_class[kind < RYX_TERM_COUNT ? kind : RYX_TERM_COUNT]];"
+           << "    if (next < RYX_DFA_FIRST_STATE) {"
+           << "      *token = t;"
+           << "      return next;"
+           << "    }"
+           << "    dfa = next;"
+           << "    ryx_token_free(t);"
+           << "    if (input->cursor != NULLPTR) {"
+           << "      // the bytes of a buffer take no token each; the cursor stays in a register."
+           << "      cursor = input->cursor;"
+           << "      end = input->end;"
+           << "      while (cursor != end) {"
+           << "        next = RYX_DFA_ROW(dfa)[ryx_dfa_byte_class[*cursor]];"
+           << "        if (next < RYX_DFA_FIRST_STATE) {"
+           << "          break;"
+           << "        }"
+           << "        cursor += 1;";
+    if (!scanner_runs.empty()) {
+      ccfile << "        if (next == dfa) {"
+             << "          // the state loops on the byte; the rest of the run is skipped at once."
+             << "          run = ryx_dfa_run[dfa / RYX_DFA_CLASS_COUNT - RYX_DFA_FIRST_STATE];"
+             << "          if (run != 0) {"
+             << "            cursor = ryx_dfa_skip(run, cursor, end);"
+             << "          }"
+             << "        }";
+    }
+    ccfile << "        dfa = next;"
+           << "      }"
+           << "      input->offset += CAST(size_t, cursor - input->cursor);"
+           << "      input->cursor = cursor;"
+           << "    }"
+           << "    t = ryx_input_next(input, offset);"
+           << "    if (t == NULLPTR) {"
+           << "      *token = NULLPTR;"
+           << "      return dfa;"
+           << "    }"
+           << "  }"
+           << "}"
+           << "INTERN_END"
+           << "";
+
+    return;
+  }
+
+  void emit_parser(void) {
+    emit_term_classes();
+    if (options.backend == codegen_backend::table) {
+      emit_parse_table();
+    }
+    if (!scanner_start.empty()) {
+      emit_scanners();
+    }
+    if (trivia) {
+      emit_trivia();
+    }
+    if (!literals.empty()) {
+      emit_literals();
+    }
+
+    if (options.flat_tree) {
+      ccfile << "INTERN"
+             << "void ryx_parser_init(struct ryx_parser* parser) {"
+             << "  ryx_stack_init(&parser->stack);"
+             << "  parser->stack.kinds[parser->stack.size++] = "
+                + token_id_to_enum_string[first_nonterm] + ";"
+             << "  parser->tree = ryx_flat_new();"
+             << "  ryx_flat_add(parser->tree, RYX_NO_NODE, "
+                + token_id_to_enum_string[first_nonterm] + ", 0);"
+             << "  parser->node = 0;";
+      emit_lexeme_init();
+      ccfile << "  parser->offset = 0;"
+             << "  parser->done = 0;"
+             << ""
+             << "  return;"
+             << "}"
+             << "INTERN_END"
+             << "";
+    } else if (options.events) {
+      ccfile << "INTERN"
+             << "void ryx_parser_init(struct ryx_parser* parser, ryx_user_data data) {"
+             << "  ryx_stack_init(&parser->stack);"
+             << "  parser->stack.kinds[parser->stack.size++] = "
+                + token_id_to_enum_string[first_nonterm] + ";"
+             << "  ryx_stack_init(&parser->open);"
+             << "  parser->data = data;"
+             << "  parser->accepted = 1;";
+      emit_lexeme_init();
+      ccfile << "  parser->offset = 0;"
+             << "  parser->done = 0;"
+             << ""
+             << "  return;"
+             << "}"
+             << "INTERN_END"
+             << "";
+    } else {
+      ccfile << "INTERN"
+             << "void ryx_parser_init(struct ryx_parser* parser) {";
+      if (options.arena) {
+        ccfile << "  struct ryx_tree_root* root;"
+               << "  struct ryx_arena* arena;";
+      }
+      ccfile << "  struct ryx_tree* ret;"
+             << "";
+      if (options.arena) {
+        ccfile << "  root = MALLOC(struct ryx_tree_root);"
+               << "  arena = &root->arena;"
+               << "  arena->chunk = NULLPTR;"
+               << "  arena->tokens = NULLPTR;"
+               << "  arena->tokens_size = 0;"
+               << "  arena->tokens_capacity = 0;"
+               << "  ret = &root->tree;";
+      } else {
+        ccfile << "  ret = MALLOC(struct ryx_tree);";
+      }
+      ccfile << "  ryx_stack_init(&parser->stack);"
+             << "  parser->stack.kinds[parser->stack.size++] = "
+                + token_id_to_enum_string[first_nonterm] + ";"
+             << "  ret->token = ryx_make_internal_token("
+                + arena_arg
+                + token_id_to_enum_string[first_nonterm]
+                + ");"
+             << "  ret->parent_node = NULLPTR;"
+             << "  ret->next_node = NULLPTR;"
+             << "  ret->sub_node_first = NULLPTR;"
+             << "  ret->sub_node_last = NULLPTR;"
+             << "  ret->offset = 0;";
+      if (options.leaves) {
+        ccfile << "  ret->end_offset = 0;";
+      }
+      ccfile << "  parser->tree = ret;"
+             << "  parser->node = ret;";
+      emit_lexeme_init();
+      ccfile << "  parser->offset = 0;"
+             << "  parser->done = 0;"
+             << ""
+             << "  return;"
+             << "}"
+             << "INTERN_END"
+             << "";
+    }
+
+    // runs until the parse ends or the input runs dry; the state stays in the parser.
+    ccfile << "INTERN"
+           << "void ryx_parser_run(struct ryx_parser* parser, struct ryx_input* input) {";
+    if (options.arena) {
+      ccfile << "  struct ryx_arena* arena;";
+    }
+    ccfile << "  struct ryx_stack stack;";
+    if (options.flat_tree) {
+      ccfile << "  struct ryx_flat* ret;"
+             << "  size_t node;";
+    } else if (options.events) {
+      ccfile << "  struct ryx_stack open;"
+             << "  ryx_user_data data;"
+             << "  int ret;";
+    } else {
+      ccfile << "  struct ryx_tree* ret;"
+             << "  struct ryx_tree* node;";
+    }
+    if (options.leaves) {
+      ccfile << "  size_t lexeme;";
+      if (options.events) {
+        ccfile << "  size_t lexeme_begin;";
+      }
+    }
+    if (!scanner_start.empty()) {
+      ccfile << "  size_t dfa;";
+    }
+    if (trivia) {
+      ccfile << "  size_t trivia;";
+    }
+    if (!literals.empty()) {
+      ccfile << "  size_t literal;";
+    }
+    ccfile << "  struct ryx_token* token;"
+           << "  size_t offset;"
+           << "  size_t term_class;"
+           << "  int finished;";
+    if (options.backend == codegen_backend::table) {
+      ccfile << "  size_t nonterm;"
+             << "  size_t action;"
+             << "  size_t i;";
+    }
+    ccfile << ""
+           << "  if (parser->done) {"
+           << "    return;"
+           << "  }"
+           << "  token = ryx_input_next(input, &offset);"
+           << "  if (token == NULLPTR) {"
+           << "    return;"
+           << "  }"
+           << "";
+    if (options.arena) {
+      ccfile << "  arena = &CAST(struct ryx_tree_root*, CAST(void*, parser->tree))->arena;";
+    }
+    ccfile << "  stack = parser->stack;";
+    if (options.events) {
+      ccfile << "  open = parser->open;"
+             << "  data = parser->data;"
+             << "  ret = 1;";
+    } else {
+      ccfile << "  ret = parser->tree;"
+             << "  node = parser->node;";
+    }
+    if (options.leaves) {
+      ccfile << "  lexeme = parser->lexeme;";
+      if (options.events) {
+        ccfile << "  lexeme_begin = parser->lexeme_begin;";
+      }
+    }
+    if (!scanner_start.empty()) {
+      ccfile << "  dfa = parser->dfa;";
+    }
+    if (trivia) {
+      ccfile << "  trivia = parser->trivia;";
+    }
+    if (!literals.empty()) {
+      ccfile << "  literal = parser->literal;";
+    }
+    ccfile << "  finished = 0;"
+           << "  term_class = ryx_class_of(token->kind);"
+           << ""
+           << "  while (!finished) {"
+           << "    switch (stack.kinds[stack.size - 1]) {";
+
+    // $
+    {
+      ccfile << "      // stack.top == $"
+             << "      case " + token_id_to_enum_string[last_term] + ":"
+             << "        ryx_stack_free(&stack);"
+             << "        if (token->kind != " + token_id_to_enum_string[last_term] + ") {";
+      emit_drop_result("          ");
+      ccfile << "        }"
+             << "        ryx_token_free(token);"
+             << "        finished = 1;"
+             << "        break;"
+             << "";
+    }
+
+    // S -> input $
+    {
+      std::string rule_description{};
+      rule_description = "S ->";
+      auto&& rule_body = rules.body(0);
+      for (auto&& rule = rule_body.begin(); rule != rule_body.end(); ++rule) {
+        rule_description += " " + id_to_token.at(*rule);
+      }
+      rule_description += " $";
+      ccfile << "      // stack.top == S"
+             << "      case " + token_id_to_enum_string[first_nonterm] + ":"
+             << "        // rule 0"
+             << "        //   " + rule_description
+             << "        stack.size -= 1;"
+             << "        ryx_stack_reserve(&stack, " + std::to_string(rule_body.size() + 2) + ");"
+             << "        stack.kinds[stack.size++] = " + token_id_to_enum_string[last_term] + ";"
+             << "        stack.kinds[stack.size++] = " + token_id_to_enum_string[special_token] + ";";
+      for (auto&& it = rule_body.rbegin(); it != rule_body.rend(); ++it) {
+        ccfile << "        stack.kinds[stack.size++] = " + token_id_to_enum_string[*it] + ";";
+      }
+      if (options.events) {
+        emit_enter(first_nonterm, "        ");
+        emit_open(token_id_to_enum_string[first_nonterm], "        ");
+      }
+      ccfile << "        break;"
+             << "";
+    }
+
+    // end of rule
+    {
+      ccfile << "      // stack.top == <end-of-body>"
+             << "      case " + token_id_to_enum_string[special_token] + ":"
+             << "        // extra rule"
+             << "        //   <end-of-body> -> (empty)"
+             << "        stack.size -= 1;";
+      if (options.leaves) {
+        // the lexemes inside the outermost one made no node.
+        ccfile << "        if (lexeme != 0) {"
+               << "          lexeme -= 1;"
+               << "          if (lexeme != 0) {"
+               << "            break;"
+               << "          }";
+        if (options.events) {
+          ccfile << "          open.size -= 1;"
+                 << "          ryx_on_lexeme(data, open.kinds[open.size], lexeme_begin, offset);"
+                 << "          break;";
+        }
+        ccfile << "        }";
+      }
+      if (options.flat_tree) {
+        ccfile << "        node = ryx_flat_close(ret, node, offset);";
+      } else if (options.events) {
+        ccfile << "        open.size -= 1;"
+               << "        ryx_on_exit(data, open.kinds[open.size]);";
+      } else if (options.leaves) {
+        ccfile << "        node->end_offset = offset;"
+               << "        node = node->parent_node;";
+      } else {
+        ccfile << "        node = node->parent_node;";
+      }
+      ccfile << "        break;"
+             << "";
+    }
+
+    // @ -> (empty)
+    {
+      ccfile << "      // stack.top == @"
+             << "      case " + token_id_to_enum_string[atmark] + ":"
+             << "        // extra rule"
+             << "        //   @ -> (empty)"
+             << "        stack.size -= 1;";
+      emit_enter(atmark, "        ");
+      if (options.events) {
+        ccfile << "        ryx_on_exit(data, " + token_id_to_enum_string[atmark] + ");";
+      }
+      ccfile << "        break;"
+             << "";
+    }
+
+    if (trivia) {
+      emit_trivia_case();
+    }
+    if (!literals.empty()) {
+      emit_literal_case();
+    }
+
+    if (options.backend == codegen_backend::table) {
+      emit_table_dispatch();
+    } else {
+      emit_switch_cases();
+      ccfile << "      default:";
+    }
+
+    // the bytes of a lexeme are covered by its node, and make none of their own.
+    std::string indent = "        ";
+    if (options.leaves && !options.events) {
+      ccfile << "        if (lexeme == 0) {";
+      indent = "          ";
+    }
+    if (options.flat_tree) {
+      ccfile << indent + "ryx_flat_add_token(ret, node, token, offset);";
+    } else if (!options.events) {
+      ccfile << indent + "node = ryx_tree_add_right_token(" + arena_arg + "node, token, offset);";
+    }
+    if (options.arena) {
+      ccfile << indent + "if (input->cursor == NULLPTR) {"
+             << indent + "  ryx_arena_add_token(arena, token);"
+             << indent + "}";
+    }
+    if (options.leaves && !options.events) {
+      ccfile << "        }";
+    }
+    if (classes.empty()) {
+      ccfile << "        if (stack.kinds[stack.size - 1] == token->kind) {";
+    } else {
+      ccfile << "        if (stack.kinds[stack.size - 1] == token->kind"
+             << "            || ryx_charset_match(stack.kinds[stack.size - 1], token->kind)) {";
+    }
+    ccfile << "          stack.size -= 1;";
+    if (options.events && options.leaves) {
+      ccfile << "          if (lexeme == 0) {"
+             << "            ryx_on_terminal(data, token, offset);"
+             << "          }"
+             << "          ryx_token_free(token);";
+    } else if (options.events) {
+      ccfile << "          ryx_on_terminal(data, token, offset);"
+             << "          ryx_token_free(token);";
+    } else if (options.leaves) {
+      ccfile << "          if (lexeme != 0) {"
+             << "            ryx_token_free(token);"
+             << "          }";
+    }
+    ccfile << "          token = ryx_input_next(input, &offset);"
+           << "          if (token == NULLPTR) {"
+           << "            finished = 1;"
+           << "          } else {"
+           << "            term_class = ryx_class_of(token->kind);"
+           << "          }"
+           << "        } else {"
+           << "          ryx_stack_free(&stack);";
+    if (options.events) {
+      ccfile << "          ryx_token_free(token);";
+    } else if (options.leaves) {
+      ccfile << "          if (lexeme != 0) {"
+             << "            ryx_token_free(token);"
+             << "          }";
+    }
+    emit_drop_result("          ");
+    ccfile << "          finished = 1;"
+           << "        }"
+           << "        break;"
+           << "    }"
+           << "  }"
+           << ""
+           << "  if (token == NULLPTR) {"
+           << "    parser->stack = stack;";
+    if (options.leaves) {
+      ccfile << "    parser->lexeme = lexeme;";
+      if (options.events) {
+        ccfile << "    parser->lexeme_begin = lexeme_begin;";
+      }
+    }
+    if (!scanner_start.empty()) {
+      ccfile << "    parser->dfa = dfa;";
+    }
+    if (trivia) {
+      ccfile << "    parser->trivia = trivia;";
+    }
+    if (!literals.empty()) {
+      ccfile << "    parser->literal = literal;";
+    }
+    if (options.events) {
+      ccfile << "    parser->open = open;"
+             << "  } else {"
+             << "    ryx_stack_free(&open);"
+             << "    parser->accepted = ret;"
+             << "    parser->done = 1;"
+             << "  }";
+    } else {
+      ccfile << "    parser->node = node;"
+             << "  } else {"
+             << "    parser->tree = ret;"
+             << "    parser->done = 1;"
+             << "  }";
+    }
+    ccfile << "  parser->offset = input->offset;"
+           << ""
+           << "  return;"
+           << "}"
+           << "INTERN_END"
+           << "";
+
+    // releases what an unfinished parse holds.
+    ccfile << "INTERN"
+           << result_type + " ryx_parser_result(struct ryx_parser* parser) {"
+           << "  if (!parser->done) {"
+           << "    ryx_stack_free(&parser->stack);";
+    if (options.flat_tree) {
+      ccfile << "    ryx_flat_free(parser->tree);"
+             << "    parser->tree = NULLPTR;";
+    } else if (options.events) {
+      ccfile << "    ryx_stack_free(&parser->open);"
+             << "    parser->accepted = 0;";
+    } else {
+      ccfile << "    ryx_tree_free(parser->tree);"
+             << "    parser->tree = NULLPTR;";
+    }
+    ccfile << "    parser->done = 1;"
+           << "  }"
+           << "";
+    if (options.flat_tree) {
+      ccfile << "  return ryx_flat_finish(parser->tree);";
+    } else if (options.events) {
+      ccfile << "  return parser->accepted;";
+    } else {
+      ccfile << "  return parser->tree;";
+    }
+    ccfile << "}"
+           << "INTERN_END"
+           << "";
+
+    // the events get the same user data as ryx_get_next_token.
+    header << "EXTERN " + result_type + " ryx_parse(ryx_user_data input);";
+    ccfile << "EXTERN " + result_type + " ryx_parse(ryx_user_data input) {"
+           << "  struct ryx_parser parser;"
+           << "  struct ryx_input in;"
+           << ""
+           << "  in.data = input;"
+           << "  in.cursor = NULLPTR;"
+           << "  in.end = NULLPTR;"
+           << "  in.offset = 0;"
+           << "  in.last = 1;"
+           << (options.events ? "  ryx_parser_init(&parser, input);" : "  ryx_parser_init(&parser);")
+           << "  ryx_parser_run(&parser, &in);"
+           << ""
+           << "  return ryx_parser_result(&parser);"
+           << "}"
+           << "";
+
+    // the terminals of the tree share static tokens; ryx_get_offset locates them in the buffer.
+    header << "EXTERN " + result_type + " ryx_parse_buffer(const char* begin, size_t len"
+              + data_param + ");";
+    ccfile << "EXTERN " + result_type + " ryx_parse_buffer(const char* begin, size_t len"
+              + data_param + ") {"
+           << "  struct ryx_parser parser;"
+           << "  struct ryx_input in;"
+           << ""
+           << "  in.data = NULLPTR;"
+           << "  in.cursor = CAST(const unsigned char*, CAST(const void*, begin));"
+           << "  in.end = in.cursor + len;"
+           << "  in.offset = 0;"
+           << "  in.last = 1;"
+           << (options.events ? "  ryx_parser_init(&parser, data);" : "  ryx_parser_init(&parser);")
+           << "  ryx_parser_run(&parser, &in);"
+           << ""
+           << "  return ryx_parser_result(&parser);"
+           << "}"
+           << "";
+
+    emit_push_parser();
+
+    if (options.mmap_file) {
+      emit_file_driver();
+    }
+
     return;
   }
 
-  template <typename T>
-  ostream_with_newlines& operator<<(T&& s) {
-    (*os) << std::forward<T>(s) << std::endl;
-    return *this;
+  // the same parser fed chunk by chunk; offsets run on across the chunks.
+  void emit_push_parser(void) {
+    header << "struct ryx_parser;"
+           << "";
+
+    std::string new_params = options.events ? "ryx_user_data data" : "void";
+    header << "EXTERN struct ryx_parser* ryx_parser_new(" + new_params + ");";
+    ccfile << "EXTERN struct ryx_parser* ryx_parser_new(" + new_params + ") {"
+           << "  struct ryx_parser* parser;"
+           << ""
+           << "  parser = MALLOC(struct ryx_parser);"
+           << (options.events ? "  ryx_parser_init(parser, data);" : "  ryx_parser_init(parser);")
+           << ""
+           << "  return parser;"
+           << "}"
+           << "";
+
+    // 0 once the input is rejected; the rest of the input need not be fed.
+    header << "EXTERN int ryx_parser_feed(struct ryx_parser* parser, const char* chunk, size_t len);";
+    ccfile << "EXTERN int ryx_parser_feed(struct ryx_parser* parser, const char* chunk, size_t len) {"
+           << "  struct ryx_input in;"
+           << ""
+           << "  in.data = NULLPTR;"
+           << "  in.cursor = CAST(const unsigned char*, CAST(const void*, chunk));"
+           << "  in.end = in.cursor + len;"
+           << "  in.offset = parser->offset;"
+           << "  in.last = 0;"
+           << "  ryx_parser_run(parser, &in);"
+           << ""
+           << "  return !parser->done;"
+           << "}"
+           << "";
+
+    // ends the input; the parser is freed either way.
+    header << "EXTERN " + result_type + " ryx_parser_finish(struct ryx_parser* parser);";
+    ccfile << "EXTERN " + result_type + " ryx_parser_finish(struct ryx_parser* parser) {"
+           << "  " + result_type + " ret;"
+           << "  struct ryx_input in;"
+           << ""
+           << "  in.data = NULLPTR;"
+           << "  in.cursor = CAST(const unsigned char*, CAST(const void*, \"\"));"
+           << "  in.end = in.cursor;"
+           << "  in.offset = parser->offset;"
+           << "  in.last = 1;"
+           << "  ryx_parser_run(parser, &in);"
+           << "  ret = ryx_parser_result(parser);"
+           << "  free(parser);"
+           << ""
+           << "  return ret;"
+           << "}"
+           << "";
+
+    return;
   }
-};
 
-extern void generate_code(std::ostream* header_,
-                          std::ostream* ccfile_,
-                          token_id first_nonterm,
-                          token_id last_term,
-                          token_id atmark,
-                          token_id special_token,
-                          const token_set_type& terminate_symbols,
-                          const token_set_type& non_terminate_symbols,
-                          const id_to_token_type& id_to_token,
-                          const token_to_id_type& token_to_id,
-                          const rules_type& rules,
-                          const table_type& table) {
-  if (header_ == nullptr || ccfile_ == nullptr) {
+  // maps the whole file and parses it as a buffer; the tree keeps only the offsets,
+  // so the mapping is released before returning.
+  void emit_file_driver(void) {
+    std::string data_arg = options.events ? ", data" : "";
+    std::string failure = options.events ? "0" : "NULLPTR";
+    header << "EXTERN " + result_type + " ryx_parse_file(const char* path" + data_param + ");";
+    ccfile << "EXTERN " + result_type + " ryx_parse_file(const char* path" + data_param + ") {"
+           << "  " + result_type + " ret;"
+           << "  struct stat st;"
+           << "  void* map;"
+           << "  size_t len;"
+           << "  int fd;"
+           << ""
+           << "  fd = open(path, O_RDONLY);"
+           << "  if (fd < 0) {"
+           << "    return " + failure + ";"
+           << "  }"
+           << "  if (fstat(fd, &st) != 0"
+           << "      || st.st_size < 0"
+           << "      || CAST(uintmax_t, st.st_size) > CAST(uintmax_t, SIZE_MAX)) {"
+           << "    close(fd);"
+           << "    return " + failure + ";"
+           << "  }"
+           << "  len = CAST(size_t, st.st_size);"
+           << "  if (len == 0) {"
+           << "    // mmap rejects the empty mapping."
+           << "    close(fd);"
+           << "    return ryx_parse_buffer(\"\", 0" + data_arg + ");"
+           << "  }"
+           << ""
+           << "  map = mmap(NULLPTR, len, PROT_READ, MAP_PRIVATE, fd, 0);"
+           << "  close(fd);"
+           << "  if (map == MAP_FAILED) {"
+           << "    return " + failure + ";"
+           << "  }"
+           << "  madvise(map, len, MADV_SEQUENTIAL);"
+           << ""
+           << "  ret = ryx_parse_buffer(CAST(const char*, map), len" + data_arg + ");"
+           << "  munmap(map, len);"
+           << ""
+           << "  return ret;"
+           << "}"
+           << "";
+
     return;
   }
 
-  ostream_with_newlines header(header_);
-  ostream_with_newlines ccfile(ccfile_);
-
-  header << "// Copyright (C) 2018 pixie-grasper"
-         << "//"
-         << "// This program is free software: you can redistribute it and/or modify"
-         << "// it under the terms of the GNU General Public License as published by"
-         << "// the Free Software Foundation, either version 3 of the License, or"
-         << "// (at your option) any later version."
-         << "//"
-         << "// This program is distributed in the hope that it will be useful,"
-         << "// but WITHOUT ANY WARRANTY; without even the implied warranty of"
-         << "// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the"
-         << "// GNU General Public License for more details."
-         << "//"
-         << "// You should have received a copy of the GNU General Public License"
-         << "// along with this program.  If not, see <https://www.gnu.org/licenses/>."
-         << "";
-
-  ccfile << "// Copyright (C) 2018 pixie-grasper"
-         << "//"
-         << "// This program is free software: you can redistribute it and/or modify"
-         << "// it under the terms of the GNU General Public License as published by"
-         << "// the Free Software Foundation, either version 3 of the License, or"
-         << "// (at your option) any later version."
-         << "//"
-         << "// This program is distributed in the hope that it will be useful,"
-         << "// but WITHOUT ANY WARRANTY; without even the implied warranty of"
-         << "// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the"
-         << "// GNU General Public License for more details."
-         << "//"
-         << "// You should have received a copy of the GNU General Public License"
-         << "// along with this program.  If not, see <https://www.gnu.org/licenses/>."
-         << "";
-
-  header << "#ifndef RYX_H_"
-         << "#define RYX_H_"
-         << "";
-
-  header << "#include <stdint.h>"
-         << "#include <stdlib.h>"
-         << "";
-
-  ccfile << "#include \"ryx_parse.h\""
-         << ""
-         << "#include <stdint.h>"
-         << "#include <stdio.h>"
-         << "#include <stdlib.h>"
-         << "";
-
-  header << "#ifdef __cplusplus"
-         << "#define INTERN namespace {"
-         << "#define INTERN_END }"
-         << "#define EXTERN extern \"C\""
-         << "#define CAST(x,y) static_cast<x>(y)"
-         << "#if __cplusplus >= 201103L"
-         << "#define NULLPTR nullptr"
-         << "#else"
-         << "#define NULLPTR 0"
-         << "#endif"
-         << "#else"
-         << "#define INTERN static"
-         << "#define INTERN_END"
-         << "#define EXTERN extern"
-         << "#define CAST(x,y) ((x)(y))"
-         << "#define NULLPTR 0"
-         << "#endif"
-         << "";
-
-  ccfile << "#define MALLOC(t) CAST(t*, malloc(sizeof(t)))"
-         << "";
-
-  header << "typedef void* ryx_user_data;"
-         << "";
-
-  header << "enum ryx_node_kind {";
-
-  std::unordered_map<token_id, std::string> token_id_to_enum_string{};
-  std::unordered_map<token_id, enum_id> token_id_to_enum_id{};
-  for (int i = 0; i < 256; ++i) {
-    std::string token_string{};
-    if (0x20 <= i && i <= 0x7E) {
-      token_string.push_back('\'');
-      token_string.push_back(static_cast<char>(i));
-      if (i == '\\') {
-        token_string.push_back(static_cast<char>(i));
+  // the parse is rejected; the tree built so far goes away.
+  void emit_drop_result(const std::string& indent) {
+    if (options.flat_tree) {
+      ccfile << indent + "ryx_flat_free(ret);"
+             << indent + "ret = NULLPTR;";
+    } else if (options.events) {
+      ccfile << indent + "ret = 0;";
+    } else {
+      ccfile << indent + "ryx_tree_free(ret);"
+             << indent + "ret = NULLPTR;";
+    }
+    return;
+  }
+
+  void emit_lexeme_init(void) {
+    if (options.leaves) {
+      ccfile << "  parser->lexeme = 0;";
+      if (options.events) {
+        ccfile << "  parser->lexeme_begin = 0;";
       }
-      token_string.push_back('\'');
+    }
+    if (!scanner_start.empty()) {
+      ccfile << "  parser->dfa = 0;";
+    }
+    if (trivia) {
+      ccfile << "  parser->trivia = 0;";
+    }
+    if (!literals.empty()) {
+      ccfile << "  parser->literal = 0;";
+    }
+    return;
+  }
+
+  // a node for the nonterm, or the event on entering it.
+  void emit_enter(token_id nts_tid, const std::string& indent) {
+    if (options.flat_tree) {
+      ccfile << indent + "ryx_flat_add(ret, node, " + token_id_to_enum_string[nts_tid] + ", offset);";
+    } else if (options.events) {
+      ccfile << indent + "ryx_on_enter(data, " + token_id_to_enum_string[nts_tid] + ", offset);";
     } else {
-      token_string = "0x";
-      token_string.push_back(itoh((i & 0xF0) >> 4));
-      token_string.push_back(itoh(i & 0x0F));
-    }
-    auto&& it = token_to_id.find(token_string);
-    if (it == token_to_id.end()) {
-      continue;
-    }
-    std::size_t number = token_id_to_enum_string.size();
-    std::string enum_string = "ryx_node_kind_char_0x";
-    enum_string.push_back(itoh((i & 0xF0) >> 4));
-    enum_string.push_back(itoh(i & 0x0F));
-    std::string header_string = "  "
-                              + enum_string
-                              + " = "
-                              + std::to_string(number)
-                              + ", // "
-                              + token_string;
-    header << header_string;
-    token_id_to_enum_string[it->second] = enum_string;
-    token_id_to_enum_id[it->second] = number;
-  }
-
-  std::set<std::string> sorted_ts_string{};
-  for (auto&& it = terminate_symbols.begin();
-              it != terminate_symbols.end();
-              ++it) {
-    if (token_id_to_enum_string.find(*it) != token_id_to_enum_string.end()) {
-      continue;
-    }
-    sorted_ts_string.insert(id_to_token.find(*it)->second);
-  }
-  enum_id enum_id_ts_base = token_id_to_enum_string.size();
-  // end of the input
-  {
-    std::size_t number = token_id_to_enum_string.size();
-    std::string enum_string = "ryx_node_kind_term_" + std::to_string(number - enum_id_ts_base);
-    std::string header_string = "  "
-                              + enum_string
-                              + " = "
-                              + std::to_string(number)
-                              + ", // $; end of the input.";
-    header << header_string;
-    token_id_to_enum_string[last_term] = enum_string;
-    token_id_to_enum_id[last_term] = number;
-  }
-  // regular TS
-  for (auto&& it = sorted_ts_string.begin(); it != sorted_ts_string.end(); ++it) {
-    std::size_t number = token_id_to_enum_string.size();
-    std::string enum_string = "ryx_node_kind_term_" + std::to_string(number - enum_id_ts_base);
-    std::string header_string = "  "
-                              + enum_string
-                              + " = "
-                              + std::to_string(number)
-                              + ", // "
-                              + *it;
-    header << header_string;
-    token_id ts_id = token_to_id.find(*it)->second;
-    token_id_to_enum_string[ts_id] = enum_string;
-    token_id_to_enum_id[ts_id] = number;
-  }
-
-  std::set<std::string> sorted_nts_string{};
-  for (auto&& it = non_terminate_symbols.begin();
-              it != non_terminate_symbols.end();
-              ++it) {
-    sorted_nts_string.insert(id_to_token.at(*it));
-  }
-  enum_id enum_id_nts_base = token_id_to_enum_string.size();
-  // stack top at the begins
-  {
-    std::size_t number = token_id_to_enum_string.size();
-    std::string enum_string = "ryx_node_kind_nonterm_"
-                            + std::to_string(number - enum_id_nts_base);
-    std::string header_string = "  "
-                              + enum_string
-                              + " = "
-                              + std::to_string(number)
-                              + ", // stack top at the begins.";
-    header << header_string;
-    token_id_to_enum_string[first_nonterm] = enum_string;
-    token_id_to_enum_id[first_nonterm] = number;
-  }
-  // special token
-  {
-    std::size_t number = token_id_to_enum_string.size();
-    std::string enum_string = "ryx_node_kind_nonterm_"
-                            + std::to_string(number - enum_id_nts_base);
-    std::string header_string = "  "
-                              + enum_string
-                              + " = "
-                              + std::to_string(number)
-                              + ", // special token.";
-    header << header_string;
-    token_id_to_enum_string[special_token] = enum_string;
-    token_id_to_enum_id[special_token] = number;
-  }
-  // regular NTS
-  for (auto&& it = sorted_nts_string.begin(); it != sorted_nts_string.end(); ++it) {
-    std::size_t number = token_id_to_enum_string.size();
-    std::string enum_string = "ryx_node_kind_nonterm_"
-                            + std::to_string(number - enum_id_nts_base);
-    std::string header_string = "  "
-                              + enum_string
-                              + " = "
-                              + std::to_string(number)
-                              + ", // "
-                              + *it;
-    token_id nts_id = token_to_id.find(*it)->second;
-    if (nts_id == first_nonterm) {
-      continue;
-    }
-    header << header_string;
-    token_id_to_enum_string[nts_id] = enum_string;
-    token_id_to_enum_id[nts_id] = number;
-  }
-
-  std::unordered_map<enum_id, token_id> enum_id_to_token_id{};
-  for (auto&& it = token_id_to_enum_id.begin(); it != token_id_to_enum_id.end(); ++it) {
-    enum_id_to_token_id[it->second] = it->first;
-  }
-
-  header << "};"
-         << "";
-
-  header << "struct ryx_token {"
-         << "  enum ryx_node_kind kind;"
-         << "  ryx_user_data data;"
-         << "  void (*free)(struct ryx_token* token);"
-         << "};"
-         << "";
-
-  header << "struct ryx_tree;"
-         << "";
-
-  ccfile << "struct ryx_tree {"
-         << "  struct ryx_token* token;"
-         << "  struct ryx_tree* parent_node;"
-         << "  struct ryx_tree* next_node;"
-         << "  struct ryx_tree* sub_node_first;"
-         << "  struct ryx_tree* sub_node_last;"
-         << "};"
-         << "";
-
-  ccfile << "struct ryx_stack {"
-         << "  struct ryx_token* token;"
-         << "  struct ryx_stack* next;"
-         << "};"
-         << "";
-
-  header << "// TODO: need to implement yourself!"
-         << "EXTERN struct ryx_token* ryx_get_next_token(ryx_user_data input);"
-         << "";
-
-  header << "// RYX interface begin";
-
-  ccfile << "INTERN"
-         << "void ryx_free_internal_token(struct ryx_token* token) {"
-         << "  free(token);"
-         << "  return;"
-         << "}"
-         << "INTERN_END"
-         << "";
-
-  ccfile << "INTERN"
-         << "void ryx_token_free(struct ryx_token* token) {"
-         << "  if (token->free != NULLPTR) {"
-         << "    token->free(token);"
-         << "  } else {"
-         << "    free(token->data);"
-         << "    free(token);"
-         << "  }"
-         << ""
-         << "  return;"
-         << "}"
-         << "INTERN_END"
-         << "";
-
-  ccfile << "INTERN"
-         << "struct ryx_token* ryx_make_internal_token(enum ryx_node_kind kind) {"
-         << "  struct ryx_token* token;"
-         << ""
-         << "  token = MALLOC(struct ryx_token);"
-         << "  token->kind = kind;"
-         << "  token->data = NULLPTR;"
-         << "  token->free = ryx_free_internal_token;"
-         << ""
-         << "  return token;"
-         << "}"
-         << "INTERN_END"
-         << "";
-
-  ccfile << "INTERN"
-         << "struct ryx_stack* ryx_stack_push(struct ryx_stack* stack,"
-         << "                                 struct ryx_token* token) {"
-         << "  struct ryx_stack* ret;"
-         << ""
-         << "  ret = MALLOC(struct ryx_stack);"
-         << "  ret->token = token;"
-         << "  ret->next = stack;"
-         << ""
-         << "  return ret;"
-         << "}"
-         << "INTERN_END"
-         << "";
-
-  ccfile << "INTERN"
-         << "struct ryx_stack* ryx_stack_pop(struct ryx_stack* stack) {"
-         << "  struct ryx_stack* ret;"
-         << ""
-         << "  ret = stack->next;"
-         << "  free(stack);"
-         << ""
-         << "  return ret;"
-         << "}"
-         << "INTERN_END"
-         << "";
-
-  ccfile << "INTERN"
-         << "void ryx_stack_free(struct ryx_stack* stack) {"
-         << "  struct ryx_stack* node;"
-         << ""
-         << "  while (stack != NULLPTR) {"
-         << "    node = stack->next;"
-         << "    free(stack);"
-         << "    stack = node;"
-         << "  }"
-         << ""
-         << "  return;"
-         << "}"
-         << "INTERN_END"
-         << "";
-
-  ccfile << "INTERN"
-         << "struct ryx_tree* ryx_tree_add_right_token(struct ryx_tree* tree,"
-         << "                                          struct ryx_token* token) {"
-         << "  if (tree->sub_node_last == NULLPTR) {"
-         << "    tree->sub_node_first = MALLOC(struct ryx_tree);"
-         << "    tree->sub_node_last = tree->sub_node_first;"
-         << "  } else {"
-         << "    tree->sub_node_last->next_node = MALLOC(struct ryx_tree);"
-         << "    tree->sub_node_last = tree->sub_node_last->next_node;"
-         << "  }"
-         << ""
-         << "  tree->sub_node_last->token = token;"
-         << "  tree->sub_node_last->parent_node = tree;"
-         << "  tree->sub_node_last->next_node = NULLPTR;"
-         << "  tree->sub_node_last->sub_node_first = NULLPTR;"
-         << "  tree->sub_node_last->sub_node_last = NULLPTR;"
-         << ""
-         << "  return tree;"
-         << "}"
-         << "INTERN_END"
-         << "";
-
-  ccfile << "INTERN"
-         << "struct ryx_tree* ryx_tree_add_right(struct ryx_tree* tree,"
-         << "                                    enum ryx_node_kind kind) {"
-         << "  return ryx_tree_add_right_token(tree, ryx_make_internal_token(kind));"
-         << "}"
-         << "INTERN_END"
-         << "";
-
-  ccfile << "INTERN"
-         << "void ryx_tree_free(struct ryx_tree* tree) {"
-         << "  struct ryx_tree* node;"
-         << ""
-         << "  if (tree == NULLPTR) {"
-         << "    return;"
-         << "  }"
-         << ""
-         << "  while (tree != NULLPTR) {"
-         << "    ryx_tree_free(tree->sub_node_first);"
-         << "    ryx_token_free(tree->token);"
-         << "    node = tree->next_node;"
-         << "    free(tree);"
-         << "    tree = node;"
-         << "  }"
-         << ""
-         << "  return;"
-         << "}"
-         << "INTERN_END"
-         << "";
-
-  header << "EXTERN struct ryx_tree* ryx_parse(ryx_user_data input);";
-  ccfile << "EXTERN struct ryx_tree* ryx_parse(ryx_user_data input) {"
-         << "  struct ryx_stack* stack;"
-         << "  struct ryx_tree* ret;"
-         << "  struct ryx_tree* node;"
-         << "  struct ryx_token* token;"
-         << "  int finished;"
-         << ""
-         << "  stack = ryx_stack_push(NULLPTR, ryx_make_internal_token("
-            + token_id_to_enum_string[first_nonterm]
-            + "));"
-         << "  ret = MALLOC(struct ryx_tree);"
-         << "  ret->token = ryx_make_internal_token("
-            + token_id_to_enum_string[first_nonterm]
-            + ");"
-         << "  ret->parent_node = NULLPTR;"
-         << "  ret->next_node = NULLPTR;"
-         << "  ret->sub_node_first = NULLPTR;"
-         << "  ret->sub_node_last = NULLPTR;"
-         << "  node = ret;"
-         << "  finished = 0;"
-         << "  token = ryx_get_next_token(input);"
-         << ""
-         << "  while (!finished) {"
-         << "    switch (stack->token->kind) {";
-
-  // $
-  {
-    ccfile << "      // stack.top == $"
-           << "      case " + token_id_to_enum_string[last_term] + ":"
-           << "        if (token->kind != " + token_id_to_enum_string[last_term] + ") {"
-           << "          ryx_tree_free(ret);"
-           << "          ret = NULLPTR;"
-           << "        }"
-           << "        ryx_stack_free(stack);"
-           << "        ryx_token_free(token);"
-           << "        finished = 1;"
-           << "        break;"
-           << "";
+      ccfile << indent + "node = ryx_tree_add_right(" + arena_arg + "node, "
+                + token_id_to_enum_string[nts_tid]
+                + ", offset);";
+    }
+    return;
   }
 
-  // S -> input $
-  {
-    std::string rule_description{};
-    rule_description = "S ->";
-    auto&& rule_body = rules.at(0).second;
-    for (auto&& rule = rule_body.begin(); rule != rule_body.end(); ++rule) {
-      rule_description += " " + id_to_token.at(*rule);
-    }
-    rule_description += " $";
-    ccfile << "      // stack.top == S"
-           << "      case " + token_id_to_enum_string[first_nonterm] + ":"
-           << "        // rule 0"
-           << "        //   " + rule_description
-           << "        stack = ryx_stack_pop(stack);"
-           << "        stack = ryx_stack_push(stack, ryx_make_internal_token("
-              + token_id_to_enum_string[last_term]
-              + "));"
-           << "        stack = ryx_stack_push(stack, ryx_make_internal_token("
-              + token_id_to_enum_string[special_token]
-              + "));";
-    for (auto&& it = rule_body.rbegin(); it != rule_body.rend(); ++it) {
-      ccfile << "        stack = ryx_stack_push(stack, ryx_make_internal_token("
-                + token_id_to_enum_string[*it]
-                + "));";
+  // the nonterm stays open until its <end-of-body> pops.
+  void emit_open(const std::string& kind, const std::string& indent) {
+    if (options.flat_tree) {
+      ccfile << indent + "node = ret->tree.size - 1;";
+    } else if (options.events) {
+      ccfile << indent + "ryx_stack_reserve(&open, 1);"
+             << indent + "open.kinds[open.size++] = " + kind + ";";
+    } else {
+      ccfile << indent + "node = node->sub_node_last;";
     }
-    ccfile << "        break;"
-           << "";
+    return;
+  }
+
+  // a lexeme with a scanner makes its leaf and stays on the top until the scanner is done;
+  // kind is the lexeme, start the first state of its scanner.
+  void emit_scan(const std::string& kind, const std::string& start, const std::string& indent) {
+    ccfile << indent + "if (dfa == 0) {"
+           << indent + "  if (lexeme == 0) {";
+    if (options.flat_tree) {
+      ccfile << indent + "    ryx_flat_add(ret, node, " + kind + ", offset);";
+    } else if (options.events) {
+      ccfile << indent + "    lexeme_begin = offset;";
+    } else {
+      ccfile << indent + "    node = ryx_tree_add_right(" + arena_arg + "node, " + kind + ", offset);";
+    }
+    ccfile << indent + "  }"
+           << indent + "  dfa = " + start + ";"
+           << indent + "}"
+           << indent + "dfa = ryx_dfa_scan(input, &token, &offset, dfa);"
+           << indent + "if (token == NULLPTR) {"
+           << indent + "  finished = 1;"
+           << indent + "  break;"
+           << indent + "} else if (dfa == RYX_DFA_ERROR) {"
+           << indent + "  ryx_stack_free(&stack);"
+           << indent + "  ryx_token_free(token);";
+    emit_drop_result(indent + "  ");
+    ccfile << indent + "  finished = 1;"
+           << indent + "  break;"
+           << indent + "}"
+           << indent + "dfa = 0;"
+           << indent + "if (lexeme == 0) {";
+    if (options.flat_tree) {
+      ccfile << indent + "  ret->tree.end_offset[ret->tree.size - 1] = offset;";
+    } else if (options.events) {
+      ccfile << indent + "  ryx_on_lexeme(data, " + kind + ", lexeme_begin, offset);";
+    } else {
+      ccfile << indent + "  node->sub_node_last->end_offset = offset;";
+    }
+    ccfile << indent + "}"
+           << indent + "stack.size -= 1;"
+           << indent + "term_class = ryx_class_of(token->kind);"
+           << indent + "break;";
+    return;
   }
 
-  // end of rule
-  {
-    ccfile << "      // stack.top == <end-of-body>"
-           << "      case " + token_id_to_enum_string[special_token] + ":"
-           << "        // extra rule"
-           << "        //   <end-of-body> -> (empty)"
-           << "        stack = ryx_stack_pop(stack);"
-           << "        node = node->parent_node;"
+  // :ws*: takes the whitespace in one go and makes no node; the lookahead after it is
+  // rejected here if :ws*: would have, so the events stop where they did.
+  void emit_trivia_case(void) {
+    ccfile << "      // stack.top == " + id_to_token.at(spaces)
+           << "      case " + token_id_to_enum_string[spaces] + ":"
+           << "        if (trivia == 0) {"
+           << "          trivia = offset + 1;"
+           << "        }"
+           << "        ryx_skip_trivia(input, &token, &offset);"
+           << "        if (token == NULLPTR) {"
+           << "          finished = 1;"
+           << "          break;"
+           << "        }"
+           << "        term_class = ryx_class_of(token->kind);"
+           << "        if (!ryx_ends_trivia(term_class)) {"
+           << "          ryx_stack_free(&stack);"
+           << "          ryx_token_free(token);";
+    emit_drop_result("          ");
+    ccfile << "          finished = 1;"
+           << "          break;"
+           << "        }";
+    if (options.flat_tree || options.events) {
+      ccfile << "        if (trivia - 1 != offset) {"
+             << (options.flat_tree ? "          ryx_flat_add_trivia(ret, trivia - 1, offset);"
+                                   : "          ryx_on_trivia(data, trivia - 1, offset);")
+             << "        }";
+    }
+    ccfile << "        trivia = 0;"
+           << "        stack.size -= 1;"
            << "        break;"
            << "";
+    return;
   }
 
-  // @ -> (empty)
-  {
-    ccfile << "      // stack.top == @"
-           << "      case " + token_id_to_enum_string[atmark] + ":"
-           << "        // extra rule"
-           << "        //   @ -> (empty)"
-           << "        stack = ryx_stack_pop(stack);"
-           << "        node = ryx_tree_add_right(node, "
-              + token_id_to_enum_string[atmark]
-              + ");"
+  // a literal stays on the top until all of its bytes are taken, and makes one leaf.
+  void emit_literal_case(void) {
+    std::string kind = "stack.kinds[stack.size - 1]";
+    std::string size = "ryx_literal_size[CAST(size_t, " + kind + ") - RYX_LITERAL_BASE]";
+    std::string begin = "offset + 1 - " + size;
+    ccfile << "      // stack.top is a literal";
+    for (enum_id eid = enum_id_literals_base; eid < enum_id_nts_base; ++eid) {
+      token_id literal_tid = enum_id_to_token_id[eid];
+      ccfile << "      case " + token_id_to_enum_string[literal_tid] + ":  // "
+                + id_to_token.at(literal_tid);
+    }
+    ccfile << "        literal = ryx_literal_scan(input, &token, &offset, " + kind + ", literal);"
+           << "        if (literal == 0) {"
+           << "          ryx_stack_free(&stack);"
+           << "          ryx_token_free(token);";
+    emit_drop_result("          ");
+    ccfile << "          finished = 1;"
+           << "          break;"
+           << "        } else if (literal != " + size + ") {"
+           << "          finished = 1;"
+           << "          break;"
+           << "        }"
+           << "        literal = 0;";
+    std::string indent = "        ";
+    if (options.leaves) {
+      ccfile << "        if (lexeme == 0) {";
+      indent = "          ";
+    }
+    if (options.flat_tree) {
+      ccfile << indent + "ryx_flat_add(ret, node, " + kind + ", " + begin + ");"
+             << indent + "ret->tree.end_offset[ret->tree.size - 1] = offset + 1;";
+    } else if (options.events) {
+      ccfile << indent + "ryx_on_terminal(data, &ryx_literal_tokens[CAST(size_t, " + kind
+                + ") - RYX_LITERAL_BASE], " + begin + ");";
+    } else {
+      ccfile << indent + "node = ryx_tree_add_right(" + arena_arg + "node, " + kind + ", " + begin + ");";
+      if (options.leaves) {
+        ccfile << indent + "node->sub_node_last->end_offset = offset + 1;";
+      }
+    }
+    if (options.leaves) {
+      ccfile << "        }";
+    }
+    ccfile << "        stack.size -= 1;"
+           << "        token = ryx_input_next(input, &offset);"
+           << "        if (token == NULLPTR) {"
+           << "          finished = 1;"
+           << "        } else {"
+           << "          term_class = ryx_class_of(token->kind);"
+           << "        }"
            << "        break;"
            << "";
+    return;
+  }
+
+  // the nonterm opens unless a lexeme is open around it; the lexemes count up.
+  void emit_lexeme_open(const std::string& kind) {
+    if (options.leaves) {
+      ccfile << "            if (lexeme == 0) {";
+      emit_open(kind, "              ");
+      ccfile << "            }"
+             << "            lexeme += ryx_nonterm_lexeme[nonterm];";
+    } else {
+      emit_open(kind, "            ");
+    }
+    return;
   }
 
-  for (enum_id nts_eid = enum_id_nts_base; nts_eid < enum_id_to_token_id.size(); ++nts_eid) {
-    token_id nts_tid = enum_id_to_token_id[nts_eid];
-    if (table.find(nts_tid) == table.end()) {
-      continue;
-    } else if (nts_tid == first_nonterm) {
-      continue;
-    } else if (nts_tid == atmark) {
-      continue;
+  // looks the action up from the tables; falls through to the terminal match.
+  void emit_table_dispatch(void) {
+    ccfile << "      default:"
+           << "        if (CAST(size_t, stack.kinds[stack.size - 1]) >= RYX_NONTERM_BASE) {"
+           << "          nonterm = CAST(size_t, stack.kinds[stack.size - 1]) - RYX_NONTERM_BASE;";
+    if (!scanner_start.empty()) {
+      ccfile << "          if (ryx_nonterm_dfa[nonterm] != 0) {";
+      emit_scan("stack.kinds[stack.size - 1]", "ryx_nonterm_dfa[nonterm]", "            ");
+      ccfile << "          }";
     }
-    ccfile << "      // stack.top == " + id_to_token.at(nts_tid)
-           << "      case " + token_id_to_enum_string[nts_tid] + ":";
-    bool generated = false;
-    if (id_to_token.at(nts_tid).back() == ']' || id_to_token.at(nts_tid).back() == '/') {
-      generated = true;
+    if (!repeats.empty()) {
+      ccfile << "          if (ryx_nonterm_repeat_max[nonterm] != 0"
+             << "              && CAST(size_t, stack.kinds[stack.size - 2]) == ryx_nonterm_repeat_max[nonterm]) {"
+             << "            stack.size -= 2;"
+             << "            break;"
+             << "          }";
     }
-    if (!generated) {
-      ccfile << "        node = ryx_tree_add_right(node, "
-                + token_id_to_enum_string[nts_tid]
-                + ");";
+    ccfile << "          action = 0;"
+           << "          if (term_class < RYX_CLASS_COUNT) {";
+    if (comb_table) {
+      ccfile << "            i = ryx_ll1_base[nonterm] + term_class;"
+             << "            if (ryx_ll1_check[i] == nonterm) {"
+             << "              action = ryx_ll1_value[i];"
+             << "            }";
+    } else {
+      ccfile << "            action = ryx_ll1_table[nonterm * RYX_CLASS_COUNT + term_class];";
+    }
+    ccfile << "          }"
+           << "          if (action == 0) {"
+           << "            ryx_stack_free(&stack);"
+           << "            ryx_token_free(token);";
+    emit_drop_result("            ");
+    ccfile << "            finished = 1;"
+           << "            break;"
+           << "          }"
+           << "          action -= 1;";
+    if (!repeats.empty()) {
+      ccfile << "          if (ryx_nonterm_repeat_max[nonterm] != 0) {"
+             << "            if (ryx_action_loop[action]) {"
+             << "              stack.kinds[stack.size - 2] = CAST(enum ryx_node_kind, CAST(size_t, stack.kinds[stack.size - 2]) + 1);"
+             << "            } else if (CAST(size_t, stack.kinds[stack.size - 2]) < ryx_nonterm_repeat_min[nonterm]) {"
+             << "              ryx_stack_free(&stack);"
+             << "              ryx_token_free(token);";
+      emit_drop_result("              ");
+      ccfile << "              finished = 1;"
+             << "              break;"
+             << "            } else {"
+             << "              stack.size -= 1;"
+             << "            }"
+             << "          }";
+    }
+    if (options.leaves) {
+      ccfile << "          if (!ryx_nonterm_transparent[nonterm] && lexeme == 0) {";
+    } else {
+      ccfile << "          if (!ryx_nonterm_transparent[nonterm]) {";
+    }
+    if (options.flat_tree) {
+      ccfile << "            ryx_flat_add(ret, node, stack.kinds[stack.size - 1], offset);";
+    } else if (options.events && options.leaves) {
+      ccfile << "            if (ryx_nonterm_lexeme[nonterm]) {"
+             << "              lexeme_begin = offset;"
+             << "            } else {"
+             << "              ryx_on_enter(data, stack.kinds[stack.size - 1], offset);"
+             << "            }";
+    } else if (options.events) {
+      ccfile << "            ryx_on_enter(data, stack.kinds[stack.size - 1], offset);";
+    } else {
+      ccfile << "            node = ryx_tree_add_right(" + arena_arg + "node, stack.kinds[stack.size - 1], offset);";
     }
-    ccfile << "        switch (token->kind) {";
-    auto&& table_row = table.at(nts_tid);
-    std::unordered_map<rule_id, std::set<enum_id>> rule_map{};
-    std::set<rule_id> rules_of_nts{};
-    for (auto&& it2 = table_row.begin(); it2 != table_row.end(); ++it2) {
-      token_id ts_tid = it2->first;
-      rule_id rid = it2->second;
-      if (rule_map.find(rid) == rule_map.end()) {
-        rule_map.insert(std::make_pair(rid, std::set<enum_id>()));
-        rules_of_nts.insert(rid);
+    ccfile << "          }"
+           << "          if (!ryx_action_loop[action]) {"
+           << "            stack.size -= 1;"
+           << "          }"
+           << "          ryx_stack_reserve(&stack, ryx_action_rhs_begin[action + 1] - ryx_action_rhs_begin[action] + 1);"
+           << "          for (i = ryx_action_rhs_begin[action]; i < ryx_action_rhs_begin[action + 1]; ++i) {"
+           << "            stack.kinds[stack.size++] = CAST(enum ryx_node_kind, ryx_action_rhs[i]);"
+           << "          }"
+           << "          if (ryx_action_push_lookahead[action]) {"
+           << "            stack.kinds[stack.size++] = token->kind;"
+           << "          }"
+           << "          if (!ryx_nonterm_transparent[nonterm]";
+    if (options.events) {
+      // an empty body pushes no <end-of-body>; the nonterm closes at once.
+      ccfile << "              && ryx_action_rhs_begin[action + 1] == ryx_action_rhs_begin[action]) {";
+      if (options.leaves) {
+        ccfile << "            if (!ryx_nonterm_lexeme[nonterm]) {"
+               << "              ryx_on_exit(data, CAST(enum ryx_node_kind, nonterm + RYX_NONTERM_BASE));"
+               << "            } else if (lexeme == 0) {"
+               << "              ryx_on_lexeme(data, CAST(enum ryx_node_kind, nonterm + RYX_NONTERM_BASE), offset, offset);"
+               << "            }";
+      } else {
+        ccfile << "            ryx_on_exit(data, CAST(enum ryx_node_kind, nonterm + RYX_NONTERM_BASE));";
       }
-      rule_map[rid].insert(token_id_to_enum_id[ts_tid]);
+      ccfile << "          } else if (!ryx_nonterm_transparent[nonterm]) {";
+      emit_lexeme_open("CAST(enum ryx_node_kind, nonterm + RYX_NONTERM_BASE)");
+    } else {
+      ccfile << "              && ryx_action_rhs_begin[action + 1] != ryx_action_rhs_begin[action]) {";
+      emit_lexeme_open("");
     }
-    rule_id empty_rule_id = rules.size();
-    for (auto&& rule_of_nts = rules_of_nts.begin();
-                rule_of_nts != rules_of_nts.end();
-                ++rule_of_nts) {
-      rule_id nts_rid = *rule_of_nts;
-      if (nts_rid != empty_rule_id) {
-        auto&& rule = rules.at(nts_rid);
-        std::string rule_description = id_to_token.at(rule.first) + " ->";
-        if (rule.second.size() == 0) {
-          rule_description += " (empty)";
+    ccfile << "          }"
+           << "          break;"
+           << "        }";
+
+    return;
+  }
+
+  // one case per nonterm, each with a switch over the class of the lookahead.
+  void emit_switch_cases(void) {
+    for (enum_id nts_eid = enum_id_nts_base; nts_eid < enum_id_to_token_id.size(); ++nts_eid) {
+      token_id nts_tid = enum_id_to_token_id[nts_eid];
+      if (!table.has_row(nts_tid)) {
+        continue;
+      } else if (nts_tid == first_nonterm) {
+        continue;
+      } else if (nts_tid == atmark) {
+        continue;
+      } else if (!scanner_start.empty() && stacked_nonterms.find(nts_tid) == stacked_nonterms.end()) {
+        continue;
+      } else if (trivia && nts_tid == spaces) {
+        continue;
+      }
+      ccfile << "      // stack.top == " + id_to_token.at(nts_tid)
+             << "      case " + token_id_to_enum_string[nts_tid] + ":";
+      auto&& scanner = scanner_start.find(nts_tid);
+      if (scanner != scanner_start.end()) {
+        emit_scan(token_id_to_enum_string[nts_tid],
+                  std::to_string(scanner_value(scanner->second + scanner_first_state)),
+                  "        ");
+        ccfile << "";
+        continue;
+      }
+      bool generated = is_generated(nts_tid);
+      bool lexeme = is_lexeme(nts_tid);
+      if (lexeme) {
+        ccfile << "        if (lexeme == 0) {";
+        if (options.events) {
+          ccfile << "          lexeme_begin = offset;";
         } else {
-          for (std::size_t i = 0; i < rule.second.size(); ++i) {
-            rule_description += " " + id_to_token.at(rule.second.at(i));
-          }
+          emit_enter(nts_tid, "          ");
+        }
+        ccfile << "        }";
+      } else if (!generated) {
+        emit_enter(nts_tid, "        ");
+      }
+      auto&& repeat = repeats.find(nts_tid);
+      if (repeat != repeats.end()) {
+        // past the most, the repetition ends whatever comes next.
+        ccfile << "        if (CAST(size_t, stack.kinds[stack.size - 2]) == "
+                  + std::to_string(repeat->second.second) + ") {"
+               << "          stack.size -= 2;"
+               << "          break;"
+               << "        }";
+      }
+      ccfile << "        switch (term_class) {";
+      auto&& action_row = action_table[nts_eid - enum_id_nts_base];
+      std::map<std::size_t, std::set<std::size_t>> action_map{};
+      for (std::size_t cls = 0; cls < class_count; ++cls) {
+        if (action_row[cls] != no_action) {
+          action_map[action_row[cls]].insert(cls);
         }
-        ccfile << "          // rule " + std::to_string(nts_rid)
-               << "          //   " + rule_description;
-        for (auto&& input_token = rule_map[nts_rid].begin();
-                    input_token != rule_map[nts_rid].end();
-                    ++input_token) {
-          token_id input_token_id = enum_id_to_token_id[*input_token];
-          ccfile << "          case " + token_id_to_enum_string[input_token_id] + ":";
-        }
-        ccfile << "            stack = ryx_stack_pop(stack);";
-        if (rule.second.size() != 0) {
-          ccfile << "            stack = ryx_stack_push(stack, ryx_make_internal_token("
-                    + token_id_to_enum_string[special_token]
-                    + "));";
-          for (auto&& it = rule.second.rbegin(); it != rule.second.rend(); ++it) {
-            ccfile << "            stack = ryx_stack_push(stack, ryx_make_internal_token("
-                      + token_id_to_enum_string[*it]
-                      + "));";
+      }
+      for (auto&& it = action_map.begin(); it != action_map.end(); ++it) {
+        auto&& action = actions[it->first];
+        auto&& symbols = action_symbols(action);
+        ccfile << "          //   " + action_description(action);
+        for (auto&& input_class = it->second.begin();
+                    input_class != it->second.end();
+                    ++input_class) {
+          ccfile << "          case " + std::to_string(*input_class) + ":  //"
+                    + class_description(*input_class);
+        }
+        if (repeat != repeats.end() && action.loops) {
+          ccfile << "            stack.kinds[stack.size - 2] = "
+                    "CAST(enum ryx_node_kind, CAST(size_t, stack.kinds[stack.size - 2]) + 1);";
+        } else if (repeat != repeats.end()) {
+          if (repeat->second.first != 0) {
+            ccfile << "            if (CAST(size_t, stack.kinds[stack.size - 2]) < "
+                      + std::to_string(repeat->second.first) + ") {"
+                   << "              ryx_stack_free(&stack);"
+                   << "              ryx_token_free(token);";
+            emit_drop_result("              ");
+            ccfile << "              finished = 1;"
+                   << "              break;"
+                   << "            }";
           }
+          ccfile << "            stack.size -= 2;";
+        } else if (!action.loops) {
+          ccfile << "            stack.size -= 1;";
+        }
+        if (symbols.size() != 0 || action.leads_with_lookahead) {
+          std::size_t push_count = symbols.size()
+                                 + repeat_count_of(symbols)
+                                 + (generated ? 0 : 1)
+                                 + (action.leads_with_lookahead ? 1 : 0);
+          ccfile << "            ryx_stack_reserve(&stack, " + std::to_string(push_count) + ");";
           if (!generated) {
-            ccfile << "            node = node->sub_node_last;";
+            ccfile << "            stack.kinds[stack.size++] = "
+                      + token_id_to_enum_string[special_token]
+                      + ";";
+          }
+          for (auto&& sym = symbols.rbegin(); sym != symbols.rend(); ++sym) {
+            if (is_repeat(*sym)) {
+              ccfile << "            stack.kinds[stack.size++] = CAST(enum ryx_node_kind, 0);";
+            }
+            ccfile << "            stack.kinds[stack.size++] = " + token_id_to_enum_string[*sym] + ";";
           }
+          if (action.leads_with_lookahead) {
+            ccfile << "            stack.kinds[stack.size++] = token->kind;";
+          }
+          if (lexeme) {
+            ccfile << "            if (lexeme == 0) {";
+            emit_open(token_id_to_enum_string[nts_tid], "              ");
+            ccfile << "            }"
+                   << "            lexeme += 1;";
+          } else if (!generated) {
+            emit_open(token_id_to_enum_string[nts_tid], "            ");
+          }
+        } else if (lexeme && options.events) {
+          ccfile << "            if (lexeme == 0) {"
+                 << "              ryx_on_lexeme(data, " + token_id_to_enum_string[nts_tid] + ", offset, offset);"
+                 << "            }";
+        } else if (!generated && options.events) {
+          ccfile << "            ryx_on_exit(data, " + token_id_to_enum_string[nts_tid] + ");";
         }
         ccfile << "            break;"
                << "";
+      }
+      ccfile << "          default:"
+             << "            ryx_stack_free(&stack);"
+             << "            ryx_token_free(token);";
+      emit_drop_result("            ");
+      ccfile << "            finished = 1;"
+             << "            break;"
+             << "        }"
+             << "        break;"
+             << "";
+    }
+
+    return;
+  }
+
+  // the lookahead moves on to the next byte of the buffer.
+  void emit_validate_advance(const std::string& indent) {
+    ccfile << indent + "cursor += 1;"
+           << indent + "kind = cursor != end ? ryx_byte_tokens[*cursor].kind : "
+              + token_id_to_enum_string[last_term] + ";"
+           << indent + "term_class = ryx_class_of(kind);";
+    return;
+  }
+
+  // the stack is full; no room for n more symbols.
+  void emit_validate_overflow(const std::string& n, const std::string& indent) {
+    ccfile << indent + "if (capacity - size < " + n + ") {"
+           << indent + "  ret = -1;"
+           << indent + "  finished = 1;"
+           << indent + "  break;"
+           << indent + "}";
+    return;
+  }
+
+  // only accepts or rejects; no tree, no token and no heap. the nonterms need not be
+  // closed, so <end-of-body> is never pushed, and a leading terminal is matched in place.
+  // the stack is the caller's; ryx_validate puts one of RYX_VALIDATE_STACK_SIZE symbols
+  // on its own stack.
+  void emit_validator(void) {
+    ccfile << "#ifndef RYX_VALIDATE_STACK_SIZE"
+           << "#define RYX_VALIDATE_STACK_SIZE 1024"
+           << "#endif"
+           << "";
+
+    // 1 if the buffer is in the language, 0 if not, -1 if the stack of capacity symbols
+    // is too small for it; error_offset gets where the input stopped unless it is NULL.
+    header << "EXTERN int ryx_validate_with_stack(const char* begin, size_t len,"
+           << "                                   enum ryx_node_kind* stack, size_t capacity,"
+           << "                                   size_t* error_offset);"
+           << "EXTERN int ryx_validate(const char* begin, size_t len, size_t* error_offset);";
+    ccfile << "EXTERN int ryx_validate_with_stack(const char* begin, size_t len,"
+           << "                                   enum ryx_node_kind* stack, size_t capacity,"
+           << "                                   size_t* error_offset) {"
+           << "  const unsigned char* cursor;"
+           << "  const unsigned char* end;"
+           << "  enum ryx_node_kind kind;"
+           << "  size_t term_class;"
+           << "  size_t size;"
+           << "  int finished;"
+           << "  int ret;";
+    if (options.backend == codegen_backend::table) {
+      ccfile << "  size_t nonterm;"
+             << "  size_t action;"
+             << "  size_t i;";
+    }
+    if (!literals.empty()) {
+      ccfile << "  size_t literal;"
+             << "  size_t n;";
+    }
+    auto&& rule_body = rules.body(0);
+    ccfile << ""
+           << "  cursor = CAST(const unsigned char*, CAST(const void*, begin));"
+           << "  end = cursor + len;"
+           << "  kind = cursor != end ? ryx_byte_tokens[*cursor].kind : "
+              + token_id_to_enum_string[last_term] + ";"
+           << "  term_class = ryx_class_of(kind);"
+           << "  ret = -1;"
+           << "  finished = 0;"
+           << "  size = 0;"
+           << "  if (capacity >= " + std::to_string(rule_body.size() + 1) + ") {"
+           << "    // rule 0"
+           << "    stack[size++] = " + token_id_to_enum_string[last_term] + ";";
+    for (auto&& it = rule_body.rbegin(); it != rule_body.rend(); ++it) {
+      ccfile << "    stack[size++] = " + token_id_to_enum_string[*it] + ";";
+    }
+    ccfile << "  } else {"
+           << "    finished = 1;"
+           << "  }"
+           << ""
+           << "  while (!finished) {"
+           << "    switch (stack[size - 1]) {"
+           << "      case " + token_id_to_enum_string[last_term] + ":"
+           << "        ret = kind == " + token_id_to_enum_string[last_term] + ";"
+           << "        finished = 1;"
+           << "        break;"
+           << ""
+           << "      case " + token_id_to_enum_string[atmark] + ":"
+           << "        size -= 1;"
+           << "        break;"
+           << "";
+
+    if (trivia) {
+      ccfile << "      case " + token_id_to_enum_string[spaces] + ":"
+             << "        while (ryx_is_trivia(term_class)) {";
+      emit_validate_advance("          ");
+      ccfile << "        }"
+             << "        size -= 1;"
+             << "        break;"
+             << "";
+    }
+
+    if (!literals.empty()) {
+      // the input stops at the first byte that differs.
+      for (enum_id eid = enum_id_literals_base; eid < enum_id_nts_base; ++eid) {
+        token_id literal_tid = enum_id_to_token_id[eid];
+        ccfile << "      case " + token_id_to_enum_string[literal_tid] + ":  // "
+                  + id_to_token.at(literal_tid);
+      }
+      ccfile << "        literal = CAST(size_t, stack[size - 1]) - RYX_LITERAL_BASE;"
+             << "        n = ryx_literal_prefix(cursor, end, ryx_literal_text[literal], ryx_literal_size[literal]);"
+             << "        if (n != ryx_literal_size[literal]) {"
+             << "          cursor += n;"
+             << "          ret = 0;"
+             << "          finished = 1;"
+             << "          break;"
+             << "        }"
+             << "        size -= 1;"
+             << "        cursor += n - 1;";
+      emit_validate_advance("        ");
+      ccfile << "        break;"
+             << "";
+    }
+
+    if (options.backend == codegen_backend::table) {
+      ccfile << "      default:"
+             << "        if (CAST(size_t, stack[size - 1]) >= RYX_NONTERM_BASE) {"
+             << "          nonterm = CAST(size_t, stack[size - 1]) - RYX_NONTERM_BASE;";
+      if (!repeats.empty()) {
+        ccfile << "          if (ryx_nonterm_repeat_max[nonterm] != 0"
+               << "              && CAST(size_t, stack[size - 2]) == ryx_nonterm_repeat_max[nonterm]) {"
+               << "            size -= 2;"
+               << "            break;"
+               << "          }";
+      }
+      ccfile << "          action = 0;"
+             << "          if (term_class < RYX_CLASS_COUNT) {";
+      if (comb_table) {
+        ccfile << "            i = ryx_ll1_base[nonterm] + term_class;"
+               << "            if (ryx_ll1_check[i] == nonterm) {"
+               << "              action = ryx_ll1_value[i];"
+               << "            }";
       } else {
+        ccfile << "            action = ryx_ll1_table[nonterm * RYX_CLASS_COUNT + term_class];";
+      }
+      ccfile << "          }"
+             << "          if (action == 0) {"
+             << "            ret = 0;"
+             << "            finished = 1;"
+             << "            break;"
+             << "          }"
+             << "          action -= 1;";
+      if (!repeats.empty()) {
+        ccfile << "          if (ryx_nonterm_repeat_max[nonterm] != 0) {"
+               << "            if (ryx_action_loop[action]) {"
+               << "              stack[size - 2] = CAST(enum ryx_node_kind, CAST(size_t, stack[size - 2]) + 1);"
+               << "            } else if (CAST(size_t, stack[size - 2]) < ryx_nonterm_repeat_min[nonterm]) {"
+               << "              ret = 0;"
+               << "              finished = 1;"
+               << "              break;"
+               << "            } else {"
+               << "              size -= 1;"
+               << "            }"
+               << "          }";
+      }
+      ccfile << "          if (!ryx_action_loop[action]) {"
+             << "            size -= 1;"
+             << "          }"
+             << "          i = ryx_action_rhs_begin[action];"
+             << "          if (i != ryx_action_rhs_begin[action + 1] && !ryx_nonterm_transparent[nonterm]) {"
+             << "            // <end-of-body>"
+             << "            i += 1;"
+             << "          }";
+      emit_validate_overflow("ryx_action_rhs_begin[action + 1] - i", "          ");
+      ccfile << "          for (; i < ryx_action_rhs_begin[action + 1]; ++i) {"
+             << "            stack[size++] = CAST(enum ryx_node_kind, ryx_action_rhs[i]);"
+             << "          }"
+             << "          if (ryx_action_push_lookahead[action]) {";
+      emit_validate_advance("            ");
+      ccfile << "          }"
+             << "          break;"
+             << "        }";
+    } else {
+      for (enum_id nts_eid = enum_id_nts_base; nts_eid < enum_id_to_token_id.size(); ++nts_eid) {
+        token_id nts_tid = enum_id_to_token_id[nts_eid];
+        if (!table.has_row(nts_tid)) {
+          continue;
+        } else if (nts_tid == first_nonterm) {
+          continue;
+        } else if (nts_tid == atmark) {
+          continue;
+        } else if (trivia && nts_tid == spaces) {
+          continue;
+        }
+        ccfile << "      // stack.top == " + id_to_token.at(nts_tid)
+               << "      case " + token_id_to_enum_string[nts_tid] + ":";
+        auto&& repeat = repeats.find(nts_tid);
+        if (repeat != repeats.end()) {
+          ccfile << "        if (CAST(size_t, stack[size - 2]) == "
+                    + std::to_string(repeat->second.second) + ") {"
+                 << "          size -= 2;"
+                 << "          break;"
+                 << "        }";
+        }
+        ccfile << "        switch (term_class) {";
+        auto&& action_row = action_table[nts_eid - enum_id_nts_base];
+        std::map<std::size_t, std::set<std::size_t>> action_map{};
+        for (std::size_t cls = 0; cls < class_count; ++cls) {
+          if (action_row[cls] != no_action) {
+            action_map[action_row[cls]].insert(cls);
+          }
+        }
+        for (auto&& it = action_map.begin(); it != action_map.end(); ++it) {
+          auto&& action = actions[it->first];
+          auto&& symbols = action_symbols(action);
+          ccfile << "          //   " + action_description(action);
+          for (auto&& input_class = it->second.begin();
+                      input_class != it->second.end();
+                      ++input_class) {
+            ccfile << "          case " + std::to_string(*input_class) + ":";
+          }
+          if (repeat != repeats.end() && action.loops) {
+            ccfile << "            stack[size - 2] = CAST(enum ryx_node_kind, CAST(size_t, stack[size - 2]) + 1);";
+          } else if (repeat != repeats.end()) {
+            if (repeat->second.first != 0) {
+              ccfile << "            if (CAST(size_t, stack[size - 2]) < "
+                        + std::to_string(repeat->second.first) + ") {"
+                     << "              ret = 0;"
+                     << "              finished = 1;"
+                     << "              break;"
+                     << "            }";
+            }
+            ccfile << "            size -= 2;";
+          } else if (!action.loops) {
+            ccfile << "            size -= 1;";
+          }
+          if (symbols.size() != 0) {
+            emit_validate_overflow(std::to_string(symbols.size() + repeat_count_of(symbols)), "            ");
+          }
+          for (auto&& sym = symbols.rbegin(); sym != symbols.rend(); ++sym) {
+            if (is_repeat(*sym)) {
+              ccfile << "            stack[size++] = CAST(enum ryx_node_kind, 0);";
+            }
+            ccfile << "            stack[size++] = " + token_id_to_enum_string[*sym] + ";";
+          }
+          if (action.leads_with_lookahead) {
+            emit_validate_advance("            ");
+          }
+          ccfile << "            break;"
+                 << "";
+        }
         ccfile << "          default:"
-               << "            ryx_tree_free(ret);"
-               << "            ryx_stack_free(stack);"
-               << "            ryx_token_free(token);"
-               << "            ret = NULLPTR;"
+               << "            ret = 0;"
                << "            finished = 1;"
                << "            break;"
+               << "        }"
+               << "        break;"
                << "";
       }
+      ccfile << "      default:";
+    }
+
+    if (classes.empty()) {
+      ccfile << "        if (stack[size - 1] == kind) {";
+    } else {
+      ccfile << "        if (stack[size - 1] == kind || ryx_charset_match(stack[size - 1], kind)) {";
     }
-    ccfile << "        }"
+    ccfile << "          size -= 1;";
+    emit_validate_advance("          ");
+    ccfile << "        } else {"
+           << "          ret = 0;"
+           << "          finished = 1;"
+           << "        }"
            << "        break;"
+           << "    }"
+           << "  }"
+           << ""
+           << "  if (ret != 1 && error_offset != NULLPTR) {"
+           << "    *error_offset = CAST(size_t, cursor - CAST(const unsigned char*, CAST(const void*, begin)));"
+           << "  }"
+           << ""
+           << "  return ret;"
+           << "}"
+           << ""
+           << "EXTERN int ryx_validate(const char* begin, size_t len, size_t* error_offset) {"
+           << "  enum ryx_node_kind stack[RYX_VALIDATE_STACK_SIZE];"
+           << ""
+           << "  return ryx_validate_with_stack(begin, len, stack, RYX_VALIDATE_STACK_SIZE, error_offset);"
+           << "}"
+           << "";
+
+    return;
+  }
+
+  // the handles are views on the arrays; a node is the index of its handle.
+  void emit_flat_accessors(void) {
+    ccfile << "INTERN"
+           << "size_t ryx_node_index(struct ryx_tree* node) {"
+           << "  return CAST(size_t, node - node->flat->nodes);"
+           << "}"
+           << "INTERN_END"
+           << "";
+
+    header << "EXTERN struct ryx_token* ryx_get_token(struct ryx_tree* node);";
+    ccfile << "EXTERN struct ryx_token* ryx_get_token(struct ryx_tree* node) {"
+           << "  size_t i;"
+           << ""
+           << "  if (node == NULL) {"
+           << "    return NULL;"
+           << "  }"
+           << ""
+           << "  i = ryx_node_index(node);"
+           << "  if (node->flat->tokens != NULLPTR && node->flat->tokens[i] != NULLPTR) {"
+           << "    return node->flat->tokens[i];"
+           << "  } else {"
+           << "    return &ryx_kind_tokens[node->flat->tree.kind[i]];"
+           << "  }"
+           << "}"
+           << "";
+
+    header << "EXTERN struct ryx_tree* ryx_get_next_node(struct ryx_tree* node);";
+    ccfile << "EXTERN struct ryx_tree* ryx_get_next_node(struct ryx_tree* node) {"
+           << "  struct ryx_flat_tree* tree;"
+           << "  size_t i;"
+           << "  size_t next;"
+           << ""
+           << "  if (node == NULL) {"
+           << "    return NULL;"
+           << "  }"
+           << ""
+           << "  tree = &node->flat->tree;"
+           << "  i = ryx_node_index(node);"
+           << "  next = i + tree->subtree_size[i];"
+           << "  if (next < tree->size && tree->parent[next] == tree->parent[i]) {"
+           << "    return &node->flat->nodes[next];"
+           << "  } else {"
+           << "    return NULL;"
+           << "  }"
+           << "}"
+           << "";
+
+    header << "EXTERN struct ryx_tree* ryx_get_sub_node(struct ryx_tree* node);";
+    ccfile << "EXTERN struct ryx_tree* ryx_get_sub_node(struct ryx_tree* node) {"
+           << "  size_t i;"
+           << ""
+           << "  if (node == NULL) {"
+           << "    return NULL;"
+           << "  }"
+           << ""
+           << "  i = ryx_node_index(node);"
+           << "  if (node->flat->tree.subtree_size[i] > 1) {"
+           << "    return &node->flat->nodes[i + 1];"
+           << "  } else {"
+           << "    return NULL;"
+           << "  }"
+           << "}"
+           << "";
+
+    header << "EXTERN size_t ryx_get_offset(struct ryx_tree* node);";
+    ccfile << "EXTERN size_t ryx_get_offset(struct ryx_tree* node) {"
+           << "  if (node == NULL) {"
+           << "    return 0;"
+           << "  } else {"
+           << "    return node->flat->tree.begin_offset[ryx_node_index(node)];"
+           << "  }"
+           << "}"
+           << "";
+
+    if (options.leaves) {
+      header << "EXTERN size_t ryx_get_end_offset(struct ryx_tree* node);";
+      ccfile << "EXTERN size_t ryx_get_end_offset(struct ryx_tree* node) {"
+             << "  if (node == NULL) {"
+             << "    return 0;"
+             << "  } else {"
+             << "    return node->flat->tree.end_offset[ryx_node_index(node)];"
+             << "  }"
+             << "}"
+             << "";
+    }
+
+    // the arrays the node is in, and its index there.
+    header << "EXTERN struct ryx_flat_tree* ryx_get_flat_tree(struct ryx_tree* node);";
+    ccfile << "EXTERN struct ryx_flat_tree* ryx_get_flat_tree(struct ryx_tree* node) {"
+           << "  if (node == NULL) {"
+           << "    return NULL;"
+           << "  } else {"
+           << "    return &node->flat->tree;"
+           << "  }"
+           << "}"
+           << "";
+
+    header << "EXTERN size_t ryx_get_index(struct ryx_tree* node);";
+    ccfile << "EXTERN size_t ryx_get_index(struct ryx_tree* node) {"
+           << "  if (node == NULL) {"
+           << "    return RYX_NO_NODE;"
+           << "  } else {"
+           << "    return ryx_node_index(node);"
+           << "  }"
+           << "}"
+           << "";
+
+    return;
+  }
+
+  void emit_accessors(void) {
+    if (options.flat_tree) {
+      emit_flat_accessors();
+    } else if (!options.events) {
+      header << "EXTERN struct ryx_token* ryx_get_token(struct ryx_tree* node);";
+      ccfile << "EXTERN struct ryx_token* ryx_get_token(struct ryx_tree* node) {"
+             << "  if (node == NULL) {"
+             << "    return NULL;"
+             << "  } else {"
+             << "    return node->token;"
+             << "  }"
+             << "}"
+             << "";
+
+      header << "EXTERN struct ryx_tree* ryx_get_next_node(struct ryx_tree* node);";
+      ccfile << "EXTERN struct ryx_tree* ryx_get_next_node(struct ryx_tree* node) {"
+             << "  if (node == NULL) {"
+             << "    return NULL;"
+             << "  } else {"
+             << "    return node->next_node;"
+             << "  }"
+             << "}"
+             << "";
+
+      header << "EXTERN struct ryx_tree* ryx_get_sub_node(struct ryx_tree* node);";
+      ccfile << "EXTERN struct ryx_tree* ryx_get_sub_node(struct ryx_tree* node) {"
+             << "  if (node == NULL) {"
+             << "    return NULL;"
+             << "  } else {"
+             << "    return node->sub_node_first;"
+             << "  }"
+             << "}"
+             << "";
+
+      // the offset of the first token the node covers; the index of the token on ryx_parse.
+      header << "EXTERN size_t ryx_get_offset(struct ryx_tree* node);";
+      ccfile << "EXTERN size_t ryx_get_offset(struct ryx_tree* node) {"
+             << "  if (node == NULL) {"
+             << "    return 0;"
+             << "  } else {"
+             << "    return node->offset;"
+             << "  }"
+             << "}"
+             << "";
+
+      // just past the last token the node covers; a lexeme leaf spans [offset, end offset).
+      if (options.leaves) {
+        header << "EXTERN size_t ryx_get_end_offset(struct ryx_tree* node);";
+        ccfile << "EXTERN size_t ryx_get_end_offset(struct ryx_tree* node) {"
+               << "  if (node == NULL) {"
+               << "    return 0;"
+               << "  } else {"
+               << "    return node->end_offset;"
+               << "  }"
+               << "}"
+               << "";
+      }
+    }
+
+    header << "// RYX interface end"
+           << "";
+
+    header << "#endif  // RYX_H_"
            << "";
+
+    return;
+  }
+
+ public:
+  code_generator(std::ostream* header_,
+                 std::ostream* ccfile_,
+                 token_id first_nonterm_,
+                 token_id last_term_,
+                 token_id atmark_,
+                 token_id special_token_,
+                 token_id spaces_,
+                 const token_set_type& terminate_symbols_,
+                 const token_set_type& non_terminate_symbols_,
+                 const classes_type& classes_,
+                 const literals_type& literals_,
+                 const repeats_type& repeats_,
+                 const token_set_type& lexemes_,
+                 const id_to_token_type& id_to_token_,
+                 const token_to_id_type& token_to_id_,
+                 const rules_type& rules_,
+                 const table_type& table_,
+                 const codegen_options& options_)
+      : header(header_),
+        ccfile(ccfile_),
+        first_nonterm(first_nonterm_),
+        last_term(last_term_),
+        atmark(atmark_),
+        special_token(special_token_),
+        spaces(spaces_),
+        terminate_symbols(terminate_symbols_),
+        non_terminate_symbols(non_terminate_symbols_),
+        classes(classes_),
+        literals(literals_),
+        repeats(repeats_),
+        lexemes(lexemes_),
+        id_to_token(id_to_token_),
+        token_to_id(token_to_id_),
+        rules(rules_),
+        table(table_),
+        options(options_),
+        token_id_to_enum_string{},
+        token_id_to_enum_id{},
+        enum_id_to_token_id{},
+        byte_to_enum_id{},
+        enum_id_ts_base(0),
+        enum_id_charsets_base(0),
+        enum_id_literals_base(0),
+        enum_id_nts_base(0),
+        actions{},
+        term_class{},
+        class_count(0),
+        action_table{},
+        comb_table(false),
+        scanner_start{},
+        scanner_next{},
+        scanner_class{},
+        scanner_class_count(0),
+        scanner_runs{},
+        scanner_run{},
+        stacked_nonterms{},
+        trivia(false),
+        trivia_classes{},
+        trivia_end_classes{},
+        arena_arg(options_.arena ? "arena, " : ""),
+        arena_param(options_.arena ? "struct ryx_arena* arena, " : ""),
+        result_type(options_.events ? "int" : "struct ryx_tree*"),
+        data_param(options_.events ? ", ryx_user_data data" : "") {
+    return;
+  }
+
+  void generate(void) {
+    if (options.trivia) {
+      for (rule_id rid = 0; rid < rules.size(); ++rid) {
+        auto&& body = rules.body(rid);
+        if (std::find(body.begin(), body.end(), spaces) != body.end() && rules.head(rid) != spaces) {
+          trivia = true;
+        }
+      }
+    }
+    emit_prologue();
+    emit_enum();
+    if (options.scanners) {
+      build_scanners();
+    }
+    emit_runtime();
+    emit_input();
+    build_term_classes();
+    if (trivia) {
+      build_trivia_classes();
+    }
+    emit_parser();
+    if (options.validator) {
+      emit_validator();
+    }
+    emit_accessors();
+    return;
+  }
+};
+
+extern void generate_code(std::ostream* header_,
+                          std::ostream* ccfile_,
+                          token_id first_nonterm,
+                          token_id last_term,
+                          token_id atmark,
+                          token_id special_token,
+                          token_id spaces,
+                          const token_set_type& terminate_symbols,
+                          const token_set_type& non_terminate_symbols,
+                          const classes_type& classes,
+                          const literals_type& literals,
+                          const repeats_type& repeats,
+                          const token_set_type& lexemes,
+                          const id_to_token_type& id_to_token,
+                          const token_to_id_type& token_to_id,
+                          const rules_type& rules,
+                          const table_type& table,
+                          const codegen_options& options) {
+  if (header_ == nullptr || ccfile_ == nullptr) {
+    return;
   }
 
-  ccfile << "      default:"
-         << "        node = ryx_tree_add_right_token(node, token);"
-         << "        if (stack->token->kind == token->kind) {"
-         << "          stack = ryx_stack_pop(stack);"
-         << "          token = ryx_get_next_token(input);"
-         << "        } else {"
-         << "          ryx_tree_free(ret);"
-         << "          ryx_stack_free(stack);"
-         << "          ret = NULLPTR;"
-         << "          finished = 1;"
-         << "        }"
-         << "        break;"
-         << "    }"
-         << "  }"
-         << ""
-         << "  return ret;"
-         << "}"
-         << "";
-
-  header << "EXTERN struct ryx_token* ryx_get_token(struct ryx_tree* node);";
-  ccfile << "EXTERN struct ryx_token* ryx_get_token(struct ryx_tree* node) {"
-         << "  if (node == NULL) {"
-         << "    return NULL;"
-         << "  } else {"
-         << "    return node->token;"
-         << "  }"
-         << "}"
-         << "";
-
-  header << "EXTERN struct ryx_tree* ryx_get_next_node(struct ryx_tree* node);";
-  ccfile << "EXTERN struct ryx_tree* ryx_get_next_node(struct ryx_tree* node) {"
-         << "  if (node == NULL) {"
-         << "    return NULL;"
-         << "  } else {"
-         << "    return node->next_node;"
-         << "  }"
-         << "}"
-         << "";
-
-  header << "EXTERN struct ryx_tree* ryx_get_sub_node(struct ryx_tree* node);";
-  ccfile << "EXTERN struct ryx_tree* ryx_get_sub_node(struct ryx_tree* node) {"
-         << "  if (node == NULL) {"
-         << "    return NULL;"
-         << "  } else {"
-         << "    return node->sub_node_first;"
-         << "  }"
-         << "}"
-         << "";
-
-  header << "// RYX interface end"
-         << "";
-
-  header << "#endif  // RYX_H_"
-         << "";
+  code_generator generator(header_,
+                           ccfile_,
+                           first_nonterm,
+                           last_term,
+                           atmark,
+                           special_token,
+                           spaces,
+                           terminate_symbols,
+                           non_terminate_symbols,
+                           classes,
+                           literals,
+                           repeats,
+                           lexemes,
+                           id_to_token,
+                           token_to_id,
+                           rules,
+                           table,
+                           options);
+  generator.generate();
 
   return;
 }
@@ -19,17 +19,63 @@
 
 #include "ryx.h"
 
+enum class codegen_backend {
+  // one switch per nonterminal, cases inline the push sequences.
+  nested_switch,
+  // a nonterminal x terminal table, flattened right hand sides and a generic driver.
+  table,
+};
+
+// how codegen_backend::table lays the LL(1) table out.
+enum class codegen_table_layout {
+  // the smaller of the two in bytes.
+  automatic,
+  // nonterm x terminal array.
+  dense,
+  // rows overlapped into one vector; base/check arrays as in yacc.
+  comb,
+};
+
+struct codegen_options {
+  // allocate the tree, the stack and the internal tokens from a chunked arena.
+  bool arena = false;
+  // emit ryx_parse_file, which maps the input file and parses it as a buffer; POSIX only.
+  bool mmap_file = false;
+  // call ryx_on_enter/ryx_on_exit/ryx_on_terminal instead of building the tree; no arena.
+  bool events = false;
+  // emit ryx_validate, which runs on a fixed stack and builds nothing.
+  bool validator = false;
+  // build the tree as parallel arrays in preorder instead of linked nodes; no arena.
+  bool flat_tree = false;
+  // collapse each lexeme nonterm into one leaf that spans its bytes.
+  bool leaves = false;
+  // run the regular lexemes through a minimized DFA instead of the prediction stack;
+  // needs leaves.
+  bool scanners = false;
+  // skip the :ws*: the `,` marker inserts in place, without nodes; the spans go to a
+  // side array of the flat tree, or to ryx_on_trivia.
+  bool trivia = false;
+  codegen_backend backend = codegen_backend::nested_switch;
+  codegen_table_layout table_layout = codegen_table_layout::automatic;
+};
+
 extern void generate_code(std::ostream* header_,
                           std::ostream* ccfile_,
                           token_id first_nonterm,
                           token_id last_term,
                           token_id atmark,
                           token_id special_token,
+                          token_id spaces,
                           const token_set_type& terminate_symbols,
                           const token_set_type& non_terminate_symbols,
+                          const classes_type& classes,
+                          const literals_type& literals,
+                          const repeats_type& repeats,
+                          const token_set_type& lexemes,
                           const id_to_token_type& id_to_token,
                           const token_to_id_type& token_to_id,
                           const rules_type& rules,
-                          const table_type& table);
+                          const table_type& table,
+                          const codegen_options& options);
 
 #endif  // CODEGEN_H_
@@ -17,12 +17,21 @@
 #include "ryx.h"
 #include "codegen.h"
 
+#include <algorithm>
 #include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstdlib>
 #include <fstream>
+#include <functional>
 #include <list>
+#include <map>
 #include <iomanip>
 #include <memory>
+#include <mutex>
 #include <set>
+#include <system_error>
+#include <thread>
 
 #define RESET   "\x1B[0m"
 #define BOLD    "\x1B[1m"
@@ -48,6 +57,9 @@ char itoh(int x) {
   }
 }
 
+const std::size_t table_type::npos;
+const std::size_t table_type::max_rules;
+
 static void put_error(void) {
   std::cout << BOLD RED ERROR RESET;
   return;
@@ -76,6 +88,110 @@ static void put_bad(void) {
   std::cout << BOLD RED "bad" RESET;
 }
 
+// runs the iterations of a loop on a fixed set of threads, the caller taking its share;
+// run() returns when every iteration is done. an iteration only writes what no other one
+// reads, so the result is the same on any number of threads.
+class thread_pool {
+ public:
+  explicit thread_pool(std::size_t threads)
+      : workers{},
+        mutex{},
+        wake{},
+        done{},
+        body(nullptr),
+        count(0),
+        next(0),
+        running(0),
+        generation(0),
+        stopping(false) {
+    for (std::size_t i = 1; i < threads; ++i) {
+      try {
+        workers.emplace_back([this] { work(); });
+      } catch (const std::system_error&) {
+        // out of threads; the ones started take the work between them.
+        break;
+      }
+    }
+    return;
+  }
+
+  thread_pool(const thread_pool&) = delete;
+  thread_pool& operator=(const thread_pool&) = delete;
+
+  ~thread_pool() {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      stopping = true;
+    }
+    wake.notify_all();
+    for (auto&& worker : workers) {
+      worker.join();
+    }
+    return;
+  }
+
+  void run(std::size_t count_, const std::function<void(std::size_t)>& body_) {
+    if (workers.empty() || count_ < 2) {
+      for (std::size_t i = 0; i < count_; ++i) {
+        body_(i);
+      }
+      return;
+    }
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      body = &body_;
+      count = count_;
+      next = 0;
+      running = workers.size();
+      generation += 1;
+    }
+    wake.notify_all();
+    take_share();
+    std::unique_lock<std::mutex> lock(mutex);
+    done.wait(lock, [this] { return running == 0; });
+    body = nullptr;
+    return;
+  }
+
+ private:
+  std::vector<std::thread> workers;
+  std::mutex mutex;
+  std::condition_variable wake, done;
+  const std::function<void(std::size_t)>* body;
+  std::size_t count;
+  std::atomic<std::size_t> next;
+  // the workers still on the current loop, and the number of the loop.
+  std::size_t running, generation;
+  bool stopping;
+
+  void take_share(void) {
+    for (std::size_t i = next++; i < count; i = next++) {
+      (*body)(i);
+    }
+    return;
+  }
+
+  void work(void) {
+    std::size_t seen = 0;
+    while (true) {
+      {
+        std::unique_lock<std::mutex> lock(mutex);
+        wake.wait(lock, [&] { return stopping || generation != seen; });
+        if (stopping) {
+          return;
+        }
+        seen = generation;
+      }
+      take_share();
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        running -= 1;
+      }
+      done.notify_one();
+    }
+  }
+};
+
 class context {
   enum class token_kind {
     /* internal symbols */
@@ -217,23 +333,43 @@ class context {
 
   struct working_memory {
     rules_type rules;
-    std::unordered_map<token_id, std::unordered_set<rule_id>> rules_of_nts;
     token_set_type ts, nts;
-    std::unordered_map<rule_id, std::unordered_set<token_id>> first;
-    std::unordered_map<token_id, std::unordered_set<token_id>> follow;
+    classes_type classes;
+    literals_type literals;
+    repeats_type repeats;
+    // the rules of the nonterm on row r of the table are
+    // rules_of_nts[rules_of_nts_begins[r]] .. rules_of_nts[rules_of_nts_begins[r + 1] - 1].
+    std::vector<std::size_t> rules_of_nts_begins;
+    std::vector<rule_id> rules_of_nts;
+    // the columns of the table by rule id, and by row; nullable tells the rules that
+    // derive <epsilon>, which has no column.
+    column_sets_type first, first_of_nts;
+    std::vector<bool> nullable, nullable_nts;
+    column_sets_type follow;
     table_type table;
+    // the nonterms defined with '=' rather than ',='.
+    token_set_type plain_nts;
+    token_set_type lexemes;
   };
 
   using shared_working_memory = std::shared_ptr<working_memory>;
+  using rule_list_type = std::vector<std::pair<token_id, std::vector<token_id>>>;
 
   token_to_id_type token_to_id;
   id_to_token_type id_to_token;
   id_to_token_type id_to_regexp_body;
+  literals_type id_to_literal;
   shared_syntax_tree parsed_input;
   shared_working_memory work;
 
   std::istream* is;
   bool verbose, quiet, table, sure_partial_book, width_limited;
+  bool arena, mmap_file, events, validator, flat_tree, leaves, scanners, trivia, literals;
+  // the threads the analysis runs on.
+  std::size_t jobs;
+  std::unique_ptr<thread_pool> pool;
+  codegen_backend backend;
+  codegen_table_layout table_layout;
   bool parsed, checked, ll1p;
   int lr, ln;
   int genid;
@@ -268,6 +404,60 @@ class context {
     return get_id(token_string + "[" + std::to_string(genid) + "]");
   }
 
+  static std::string byte_token_string(std::size_t c) {
+    std::string token_string{};
+    if (0x20 <= c && c <= 0x7E) {
+      token_string.push_back('\'');
+      token_string.push_back(static_cast<char>(c));
+      if (c == '\\') {
+        token_string.push_back(static_cast<char>(c));
+      }
+      token_string.push_back('\'');
+    } else {
+      token_string = "0x";
+      token_string.push_back(itoh(static_cast<int>((c & 0xF0) >> 4)));
+      token_string.push_back(itoh(static_cast<int>(c & 0x0F)));
+    }
+    return token_string;
+  }
+
+  // registers the character class as one terminal; its bytes are registered too,
+  // they are the columns of the table the class spreads over.
+  token_id get_class_id(const shared_working_memory& current_work,
+                        std::unordered_set<token_id>* ts,
+                        const std::string& class_string,
+                        const char_class_type& chars) {
+    token_id class_id = get_id(":" + class_string + ":");
+    for (std::size_t c = 0; c < 256; ++c) {
+      if (chars[c]) {
+        ts->insert(get_id(byte_token_string(c)));
+      }
+    }
+    ts->insert(class_id);
+    current_work->classes[class_id] = chars;
+    return class_id;
+  }
+
+  // a quoted string of two or more bytes, as one terminal; the bytes that are not
+  // printable are escaped, so that no two strings share the name.
+  token_id get_literal_id(const std::string& bytes) {
+    std::string token_string = "'";
+    for (auto&& it = bytes.begin(); it != bytes.end(); ++it) {
+      int c = static_cast<unsigned char>(*it);
+      if (0x20 <= c && c <= 0x7E) {
+        token_string.push_back(static_cast<char>(c));
+      } else {
+        token_string += "\\x";
+        token_string.push_back(itoh((c & 0xF0) >> 4));
+        token_string.push_back(itoh(c & 0x0F));
+      }
+    }
+    token_string.push_back('\'');
+    token_id id = get_id(token_string);
+    id_to_literal[id] = bytes;
+    return id;
+  }
+
   void put_error_while_get_token(void) {
     std::cout << std::endl;
     put_linenumber();
@@ -316,6 +506,54 @@ class context {
     return;
   }
 
+  // the byte a character between the quotes stands for, or -1 on an unknown escape.
+  int get_quoted_byte(int ch) {
+    if (ch != '\\') {
+      return ch;
+    }
+    ch = is->get();
+    switch (ch) {
+      case 'n':
+        return 0x0A;
+
+      case 'r':
+        return 0x0D;
+
+      case 's':
+        return ' ';
+
+      case 't':
+        return 0x09;
+
+      default:
+        put_error_while_get_token();
+        return -1;
+    }
+  }
+
+  // with -k, the rest of the quoted string from its first character ch on.
+  token get_quoted_string(int ch) {
+    std::string bytes{};
+    while (ch != current_quote) {
+      if (ch == EOF) {
+        return token(token_kind::invalid);
+      }
+      int byte = get_quoted_byte(ch);
+      if (byte < 0) {
+        return token(token_kind::invalid);
+      }
+      bytes.push_back(static_cast<char>(byte));
+      ch = is->get();
+    }
+    current_quote = '\0';
+
+    if (bytes.size() == 1) {
+      return token(token_kind::id, get_id(byte_token_string(static_cast<unsigned char>(bytes[0]))));
+    } else {
+      return token(token_kind::id, get_literal_id(bytes));
+    }
+  }
+
   token get_token() {
     if (is == nullptr) {
       return token(token_kind::invalid);
@@ -331,41 +569,14 @@ class context {
         } else if (ch == current_quote) {
           current_quote = '\0';
           continue;
+        } else if (literals) {
+          return get_quoted_string(ch);
         } else {
-          std::string token_string{};
-          if (0x20 <= ch && ch <= 0x7E && ch != '\\') {
-            token_string.push_back('\'');
-            token_string.push_back(static_cast<char>(ch));
-            token_string.push_back('\'');
-          } else if (ch == '\\') {
-            ch = is->get();
-            switch (ch) {
-              case 'n':
-                token_string = "0x0A";
-                break;
-
-              case 'r':
-                token_string = "0x0D";
-                break;
-
-              case 's':
-                token_string = "' '";
-                break;
-
-              case 't':
-                token_string = "0x09";
-                break;
-
-              default:
-                put_error_while_get_token();
-                return token(token_kind::invalid);
-            }
-          } else {
-            token_string = "0x";
-            token_string.push_back(itoh((ch & 0xF0) >> 4));
-            token_string.push_back(itoh(ch & 0x0F));
+          int byte = get_quoted_byte(ch);
+          if (byte < 0) {
+            return token(token_kind::invalid);
           }
-          return token(token_kind::id, get_id(std::move(token_string)));
+          return token(token_kind::id, get_id(byte_token_string(static_cast<std::size_t>(byte))));
         }
       }
       switch (ch) {
@@ -1187,10 +1398,44 @@ class context {
   void add_rule(const shared_working_memory& current_work,
                 token_id head_id,
                 std::vector<token_id>&& rule) {
-    rule_id rule_id = current_work->rules.size();
-    current_work->rules.insert(std::make_pair(rule_id,
-                                              std::make_pair(head_id, std::move(rule))));
-    current_work->rules_of_nts[head_id].insert(rule_id);
+    current_work->rules.add(head_id, rule);
+    return;
+  }
+
+  // whether the counts are a range with more than one x at most; a counter takes them.
+  static bool is_count_range(const std::set<int>& combination) {
+    int min = *combination.begin();
+    int max = *combination.rbegin();
+    return max >= 2 && static_cast<std::size_t>(max - min + 1) == combination.size();
+  }
+
+  // x{min,max} as one helper that counts the x on the stack, X[n] -> x X[n] | (empty),
+  // instead of a helper per count; a leading x that is always there goes ahead of it,
+  // so that the helper is only nullable where the repetition is.
+  void add_counted_repetition(const shared_working_memory& current_work,
+                              std::vector<std::pair<token_id, std::shared_ptr<std::vector<token_id>>>>* rules,
+                              std::unordered_set<token_id>* nts,
+                              const std::shared_ptr<std::vector<token_id>>& rule,
+                              token_id base_id,
+                              token_id target_id,
+                              const std::set<int>& combination) {
+    std::size_t min = static_cast<std::size_t>(*combination.begin());
+    std::size_t max = static_cast<std::size_t>(*combination.rbegin());
+    if (min != 0) {
+      rule->push_back(target_id);
+      min -= 1;
+      max -= 1;
+    }
+
+    token_id repeat_id = gen_id(id_to_token[base_id]);
+    nts->insert(repeat_id);
+    rule->push_back(repeat_id);
+    std::shared_ptr<std::vector<token_id>> repeat_rule = std::make_shared<std::vector<token_id>>();
+    repeat_rule->push_back(target_id);
+    repeat_rule->push_back(repeat_id);
+    rules->push_back(std::make_pair(repeat_id, repeat_rule));
+    rules->push_back(std::make_pair(repeat_id, std::make_shared<std::vector<token_id>>()));
+    current_work->repeats[repeat_id] = std::make_pair(min, max);
     return;
   }
 
@@ -1268,6 +1513,9 @@ class context {
       if (nts.find(head_id) == nts.end()) {
         nts.insert(head_id);
       }
+      if (define_rule[i]->subtree[1]->subtree.empty()) {
+        ret->plain_nts.insert(head_id);
+      }
     }
     for (std::size_t i = 0; i < define_ts.size(); ++i) {
       shared_syntax_tree id_ = define_ts[i]->subtree[1];
@@ -1509,81 +1757,85 @@ class context {
             break;
         }
       }
-      if (combination.find(0) != combination.end()) {
-        nullable = true;
-        combination.erase(0);
+      if (!nullable && !infinitable && is_count_range(combination)) {
+        add_counted_repetition(ret, &rules, &nts, rule, base_id, target_id, combination);
+      } else {
+        if (combination.find(0) != combination.end()) {
+          nullable = true;
+          combination.erase(0);
 
-        if (combination.size() == 0) {
-          continue;
+          if (combination.size() == 0) {
+            continue;
+          }
         }
-      }
 
-      token_id original_target_id = target_id;
-      if (combination.size() != 1 || combination.find(1) == combination.end()) {
-        target_id = gen_id(id_to_token[base_id]);
-        nts.insert(target_id);
-      }
-
-      if (nullable) {
-        std::shared_ptr<std::vector<token_id>> dummy_rule = nullptr;
-        token_id dummy_target_id = gen_id(id_to_token[base_id]);
-        nts.insert(dummy_target_id);
-        rule->push_back(dummy_target_id);
-
-        dummy_rule = std::make_shared<std::vector<token_id>>();
-        rules.push_back(std::make_pair(dummy_target_id, dummy_rule));
-        dummy_rule->push_back(target_id);
-        if (infinitable) {
-          dummy_rule->push_back(dummy_target_id);
+        token_id original_target_id = target_id;
+        if (combination.size() != 1 || combination.find(1) == combination.end()) {
+          target_id = gen_id(id_to_token[base_id]);
+          nts.insert(target_id);
         }
 
-        dummy_rule = std::make_shared<std::vector<token_id>>();
-        rules.push_back(std::make_pair(dummy_target_id, dummy_rule));
-      } else if (infinitable) {
-        std::shared_ptr<std::vector<token_id>> dummy_rule = nullptr;
-        token_id dummy_target_id = gen_id(id_to_token[base_id]);
-        nts.insert(dummy_target_id);
-        rule->push_back(target_id);
-        rule->push_back(dummy_target_id);
-
-        dummy_rule = std::make_shared<std::vector<token_id>>();
-        rules.push_back(std::make_pair(dummy_target_id, dummy_rule));
-        dummy_rule->push_back(target_id);
-        dummy_rule->push_back(dummy_target_id);
-
-        dummy_rule = std::make_shared<std::vector<token_id>>();
-        rules.push_back(std::make_pair(dummy_target_id, dummy_rule));
-      }
-
-      if (combination.size() != 1 || combination.find(1) == combination.end()) {
-        std::shared_ptr<std::vector<token_id>> dummy_rule = nullptr;
-        token_id dummy_target_id;
-        if (nullable || infinitable) {
-          dummy_target_id = target_id;
-        } else {
-          dummy_target_id = gen_id(id_to_token[base_id]);
+        if (nullable) {
+          std::shared_ptr<std::vector<token_id>> dummy_rule = nullptr;
+          token_id dummy_target_id = gen_id(id_to_token[base_id]);
           nts.insert(dummy_target_id);
           rule->push_back(dummy_target_id);
-        }
 
-        int count = 0;
-        for (auto&& it = combination.begin(); it != combination.end(); ++it) {
           dummy_rule = std::make_shared<std::vector<token_id>>();
           rules.push_back(std::make_pair(dummy_target_id, dummy_rule));
-          while (count < *it) {
-            dummy_rule->push_back(original_target_id);
-            ++count;
+          dummy_rule->push_back(target_id);
+          if (infinitable) {
+            dummy_rule->push_back(dummy_target_id);
           }
-          dummy_target_id = gen_id(id_to_token[base_id]);
+
+          dummy_rule = std::make_shared<std::vector<token_id>>();
+          rules.push_back(std::make_pair(dummy_target_id, dummy_rule));
+        } else if (infinitable) {
+          std::shared_ptr<std::vector<token_id>> dummy_rule = nullptr;
+          token_id dummy_target_id = gen_id(id_to_token[base_id]);
           nts.insert(dummy_target_id);
+          rule->push_back(target_id);
+          rule->push_back(dummy_target_id);
+
+          dummy_rule = std::make_shared<std::vector<token_id>>();
+          rules.push_back(std::make_pair(dummy_target_id, dummy_rule));
+          dummy_rule->push_back(target_id);
           dummy_rule->push_back(dummy_target_id);
+
           dummy_rule = std::make_shared<std::vector<token_id>>();
           rules.push_back(std::make_pair(dummy_target_id, dummy_rule));
         }
 
-        target_id = original_target_id;
-      } else if (!nullable && !infinitable) {
-        rule->push_back(target_id);
+        if (combination.size() != 1 || combination.find(1) == combination.end()) {
+          std::shared_ptr<std::vector<token_id>> dummy_rule = nullptr;
+          token_id dummy_target_id;
+          if (nullable || infinitable) {
+            dummy_target_id = target_id;
+          } else {
+            dummy_target_id = gen_id(id_to_token[base_id]);
+            nts.insert(dummy_target_id);
+            rule->push_back(dummy_target_id);
+          }
+
+          int count = 0;
+          for (auto&& it = combination.begin(); it != combination.end(); ++it) {
+            dummy_rule = std::make_shared<std::vector<token_id>>();
+            rules.push_back(std::make_pair(dummy_target_id, dummy_rule));
+            while (count < *it) {
+              dummy_rule->push_back(original_target_id);
+              ++count;
+            }
+            dummy_target_id = gen_id(id_to_token[base_id]);
+            nts.insert(dummy_target_id);
+            dummy_rule->push_back(dummy_target_id);
+            dummy_rule = std::make_shared<std::vector<token_id>>();
+            rules.push_back(std::make_pair(dummy_target_id, dummy_rule));
+          }
+
+          target_id = original_target_id;
+        } else if (!nullable && !infinitable) {
+          rule->push_back(target_id);
+        }
       }
 
       if (generated) {
@@ -1639,13 +1891,8 @@ class context {
 
               case '[': {
                 std::size_t j = 1;
-                symbol_id = gen_id(id_to_token[base_id]);
-                nts.insert(symbol_id);
                 bool reversed = false;
-                std::vector<bool> chars{};
-                for (std::size_t c = 0; c < 256; ++c) {
-                  chars.push_back(false);
-                }
+                char_class_type chars{};
                 if (tokens[i]->at(j) == '^') {
                   reversed = true;
                   ++j;
@@ -1699,64 +1946,16 @@ class context {
                   }
                 }
                 if (reversed) {
-                  for (std::size_t c = 0; c < 256; ++c) {
-                    chars[c] = !chars[c];
-                  }
-                }
-                for (std::size_t c = 0; c < 256; ++c) {
-                  std::string token_string{};
-                  if (chars[c]) {
-                    if (0x20 <= c && c <= 0x7E) {
-                      token_string.push_back('\'');
-                      token_string.push_back(static_cast<char>(c));
-                      if (c == '\\') {
-                        token_string.push_back(static_cast<char>(c));
-                      }
-                      token_string.push_back('\'');
-                    } else {
-                      token_string = "0x";
-                      token_string.push_back(itoh((c & 0xF0) >> 4));
-                      token_string.push_back(itoh(c & 0x0F));
-                    }
-                    std::shared_ptr<std::vector<token_id>> dummy_rule =
-                      std::make_shared<std::vector<token_id>>();
-                    token_id ts_id = get_id(token_string);
-                    if (ts.find(ts_id) == ts.end()) {
-                      ts.insert(ts_id);
-                    }
-                    dummy_rule->push_back(ts_id);
-                    rules.push_back(std::make_pair(symbol_id, dummy_rule));
-                  }
+                  chars.flip();
                 }
+                symbol_id = get_class_id(ret, &ts, *tokens[i], chars);
                 break;
               }
 
               case '.': {
-                symbol_id = gen_id(id_to_token[base_id]);
-                nts.insert(symbol_id);
-                for (int c = 0; c < 256; ++c) {
-                  std::string token_string{};
-                  if (0x20 <= c && c <= 0x7E) {
-                    token_string.push_back('\'');
-                    token_string.push_back(static_cast<char>(c));
-                    if (c == '\\') {
-                      token_string.push_back(static_cast<char>(c));
-                    }
-                    token_string.push_back('\'');
-                  } else {
-                    token_string = "0x";
-                    token_string.push_back(itoh((c & 0xF0) >> 4));
-                    token_string.push_back(itoh(c & 0x0F));
-                  }
-                  std::shared_ptr<std::vector<token_id>> dummy_rule =
-                    std::make_shared<std::vector<token_id>>();
-                  token_id ts_id = get_id(token_string);
-                  if (ts.find(ts_id) == ts.end()) {
-                    ts.insert(ts_id);
-                  }
-                  dummy_rule->push_back(ts_id);
-                  rules.push_back(std::make_pair(symbol_id, dummy_rule));
-                }
+                char_class_type chars{};
+                chars.set();
+                symbol_id = get_class_id(ret, &ts, *tokens[i], chars);
                 break;
               }
 
@@ -1847,6 +2046,11 @@ class context {
               ++i;
             }
 
+            if (!nullable && !infinitable && is_count_range(combination)) {
+              add_counted_repetition(ret, &rules, &nts, rule, base_id, symbol_id, combination);
+              continue;
+            }
+
             token_id original_symbol_id = symbol_id;
             if (combination.size() != 1 || combination.find(1) == combination.end()) {
               symbol_id = gen_id(id_to_token[base_id]);
@@ -1921,6 +2125,15 @@ class context {
           if (ts.find(target_id) == ts.end()) {
             ts.insert(target_id);
           }
+          // a literal is predicted on its first byte, and its bytes come from the input
+          // one by one; they are registered as the bytes of a character class are.
+          auto&& literal = id_to_literal.find(target_id);
+          if (literal != id_to_literal.end()) {
+            for (auto&& c = literal->second.begin(); c != literal->second.end(); ++c) {
+              ts.insert(get_id(byte_token_string(static_cast<unsigned char>(*c))));
+            }
+            ret->literals[target_id] = literal->second;
+          }
         } else if (nts.find(target_id) == nts.end() &&
                    ts.find(target_id) == ts.end()) {
           if (unknown.find(target_id) == unknown.end()) {
@@ -1968,98 +2181,665 @@ class context {
 
     if (verbose) {
       std::cout << "rule-list:" << std::endl;
-      for (rule_id rule_id = 0; rule_id < ret->rules.size(); ++rule_id) {
-        std::cout << "  # rule " << static_cast<int>(rule_id) << std::endl;
-        std::cout << "  " << id_to_token[ret->rules[rule_id].first] << " =";
-        for (auto&& body = ret->rules[rule_id].second.begin();
-                    body != ret->rules[rule_id].second.end();
-                    ++body) {
-          std::cout << " " << id_to_token[*body];
-        }
-        std::cout << ";" << std::endl << std::endl;
+      put_rule_list(ret);
+    }
+
+    return ret;
+  }
+
+  void put_rule_list(const shared_working_memory& current_work) {
+    for (rule_id rule_id = 0; rule_id < current_work->rules.size(); ++rule_id) {
+      std::cout << "  # rule " << static_cast<int>(rule_id) << std::endl;
+      std::cout << "  " << id_to_token[current_work->rules.head(rule_id)] << " =";
+      for (auto&& body = current_work->rules.body(rule_id).begin();
+                  body != current_work->rules.body(rule_id).end();
+                  ++body) {
+        std::cout << " " << id_to_token[*body];
       }
+      std::cout << ";" << std::endl << std::endl;
     }
+    return;
+  }
 
+  rule_list_type rule_list(void) {
+    rule_list_type ret{};
+    for (rule_id rule_id = 0; rule_id < work->rules.size(); ++rule_id) {
+      auto&& body = work->rules.body(rule_id);
+      ret.push_back(std::make_pair(work->rules.head(rule_id),
+                                   std::vector<token_id>(body.begin(), body.end())));
+    }
     return ret;
   }
 
-  bool build_first_set(void) {
-    token_id eid = get_id("<epsilon>");
-    std::unordered_map<rule_id, bool> complete_to_build{};
-    for (auto&& it = work->rules.begin(); it != work->rules.end(); ++it) {
-      rule_id rule_id = it->first;
-      work->first.insert(std::make_pair(rule_id, std::unordered_set<token_id>()));
-      complete_to_build[rule_id] = false;
-    }
-
-    bool updated = true;
-    while (updated) {
-      updated = false;
-      for (auto&& it = work->rules.begin(); it != work->rules.end(); ++it) {
-        rule_id target_rule_id = it->first;
-        if (complete_to_build[target_rule_id]) {
+  // renumbers the rules in the order of the list.
+  void set_rule_list(rule_list_type&& rules) {
+    work->rules.clear();
+    for (auto&& rule = rules.begin(); rule != rules.end(); ++rule) {
+      add_rule(work, rule->first, std::move(rule->second));
+    }
+    return;
+  }
+
+  // takes the generated helpers out where that leaves the parser nothing new to decide:
+  // a helper with one rule goes into its only use, or into every use when the rule is a
+  // symbol at most; a helper used once as the only rule of a nonterm hands its rules to
+  // that nonterm. the helpers make no node, so the tree stays as it was, and no rule
+  // competes with one it did not before, so the table stays LL(1).
+  bool inline_helpers(void) {
+    rule_list_type rules = rule_list();
+    auto&& is_helper = [&](token_id id) {
+      const std::string& name = id_to_token[id];
+      return name.back() == ']' || name.back() == '/';
+    };
+
+    // the rules stay in their slots, and order lists the live ones; a helper is looked up
+    // through the rules of its head and the rules its uses are in, so an inline only
+    // touches those. users may hold a rule twice, or one that no longer uses the symbol.
+    std::list<std::size_t> order{};
+    std::vector<std::list<std::size_t>::iterator> place_of{};
+    std::unordered_map<token_id, std::vector<std::size_t>> rules_of{}, users{};
+    std::unordered_map<token_id, std::size_t> use_count{};
+    for (std::size_t rule = 0; rule < rules.size(); ++rule) {
+      place_of.push_back(order.insert(order.end(), rule));
+      rules_of[rules[rule].first].push_back(rule);
+      for (auto&& symbol = rules[rule].second.begin(); symbol != rules[rule].second.end(); ++symbol) {
+        use_count[*symbol] += 1;
+        users[*symbol].push_back(rule);
+      }
+    }
+    auto&& users_of = [&](token_id id) {
+      std::vector<std::size_t>& list = users[id];
+      std::sort(list.begin(), list.end());
+      list.erase(std::unique(list.begin(), list.end()), list.end());
+      list.erase(std::remove_if(list.begin(), list.end(), [&](std::size_t rule) {
+                   const std::vector<token_id>& body = rules[rule].second;
+                   return std::find(body.begin(), body.end(), id) == body.end();
+                 }),
+                 list.end());
+      return list;
+    };
+
+    // a helper is tried again once a rule it is the head of, or is used in, changes.
+    std::vector<token_id> queue{};
+    std::size_t queue_head = 0;
+    std::unordered_set<token_id> queued{};
+    auto&& push = [&](token_id id) {
+      if (is_helper(id) && queued.insert(id).second) {
+        queue.push_back(id);
+      }
+    };
+    auto&& push_rule = [&](std::size_t rule) {
+      push(rules[rule].first);
+      for (auto&& symbol = rules[rule].second.begin(); symbol != rules[rule].second.end(); ++symbol) {
+        push(*symbol);
+      }
+    };
+    for (auto&& rule = rules.begin(); rule != rules.end(); ++rule) {
+      push(rule->first);
+    }
+
+    bool inlined = false;
+    while (queue_head < queue.size()) {
+      token_id helper_id = queue[queue_head++];
+      queued.erase(helper_id);
+      std::vector<std::size_t>& helper_rules = rules_of[helper_id];
+      if (helper_rules.empty() || use_count[helper_id] == 0) {
+        continue;
+      } else if (work->repeats.find(helper_id) != work->repeats.end()) {
+        continue;
+      }
+      bool recursive = false;
+      for (auto&& rule = helper_rules.begin(); rule != helper_rules.end(); ++rule) {
+        const std::vector<token_id>& body = rules[*rule].second;
+        recursive |= std::find(body.begin(), body.end(), helper_id) != body.end();
+      }
+      if (recursive) {
+        continue;
+      }
+
+      if (helper_rules.size() == 1) {
+        std::vector<token_id> helper_body = rules[helper_rules.front()].second;
+        if (use_count[helper_id] != 1 && helper_body.size() > 1) {
           continue;
         }
-        bool need_to_update = false;
-        bool has_epsilon = true;
-        for (std::size_t body_index = 0;
-                         body_index < it->second.second.size() && has_epsilon;
-                         ++body_index) {
-          has_epsilon = false;
-          token_id body_token_id = it->second.second[body_index];
-          if (work->ts.find(body_token_id) == work->ts.end()) {
-            for (auto&& rule = work->rules_of_nts[body_token_id].begin();
-                        rule != work->rules_of_nts[body_token_id].end();
-                        ++rule) {
-              rule_id depending_rule_id = *rule;
-              if (!complete_to_build[depending_rule_id]) {
-                need_to_update = true;
-              } else {
-                for (auto&& first = work->first[depending_rule_id].begin();
-                            first != work->first[depending_rule_id].end();
-                            ++first) {
-                  token_id first_id = *first;
-                  if (*first == eid) {
-                    has_epsilon = true;
-                  } else if (work->first[target_rule_id].find(first_id) ==
-                             work->first[target_rule_id].end()) {
-                    updated = true;
-                    work->first[target_rule_id].insert(first_id);
-                  }
-                }
-              }
+        std::vector<std::size_t> user_rules = users_of(helper_id);
+        std::vector<std::vector<token_id>> bodies{};
+        bool endless = false;
+        for (auto&& rule = user_rules.begin(); rule != user_rules.end(); ++rule) {
+          std::vector<token_id> body{};
+          for (auto&& symbol = rules[*rule].second.begin(); symbol != rules[*rule].second.end(); ++symbol) {
+            if (*symbol == helper_id) {
+              body.insert(body.end(), helper_body.begin(), helper_body.end());
+            } else {
+              body.push_back(*symbol);
             }
-          } else {
-            if (work->first[target_rule_id].find(body_token_id) ==
-                work->first[target_rule_id].end()) {
-              updated = true;
-              work->first[target_rule_id].insert(body_token_id);
+          }
+          // a rule of nothing but its head would never end.
+          if (body.size() == 1 && body.front() == rules[*rule].first) {
+            endless = true;
+          }
+          bodies.push_back(std::move(body));
+        }
+        if (endless) {
+          continue;
+        }
+
+        for (std::size_t i = 0; i < user_rules.size(); ++i) {
+          std::size_t rule = user_rules[i];
+          std::size_t uses = static_cast<std::size_t>(
+              std::count(rules[rule].second.begin(), rules[rule].second.end(), helper_id));
+          for (auto&& symbol = helper_body.begin(); symbol != helper_body.end(); ++symbol) {
+            use_count[*symbol] += uses;
+            users[*symbol].push_back(rule);
+          }
+          rules[rule].second = std::move(bodies[i]);
+          push_rule(rule);
+        }
+        for (auto&& symbol = helper_body.begin(); symbol != helper_body.end(); ++symbol) {
+          use_count[*symbol] -= 1;
+        }
+        order.erase(place_of[helper_rules.front()]);
+        rules[helper_rules.front()].second.clear();
+      } else {
+        // a regexp helper is shared by its text; another use would keep pointing at it.
+        if (use_count[helper_id] != 1) {
+          continue;
+        }
+        std::size_t user = users_of(helper_id).front();
+        token_id user_id = rules[user].first;
+        if (rules[user].second.size() != 1 || rules_of[user_id].size() != 1
+            || work->repeats.find(user_id) != work->repeats.end()) {
+          continue;
+        }
+        for (auto&& rule = helper_rules.begin(); rule != helper_rules.end(); ++rule) {
+          rules[*rule].first = user_id;
+          order.splice(place_of[user], order, place_of[*rule]);
+          push_rule(*rule);
+        }
+        order.erase(place_of[user]);
+        rules[user].second.clear();
+        rules_of[user_id] = std::move(helper_rules);
+      }
+
+      helper_rules.clear();
+      use_count[helper_id] = 0;
+      work->nts.erase(helper_id);
+      inlined = true;
+    }
+
+    if (inlined) {
+      rule_list_type rest{};
+      for (auto&& rule = order.begin(); rule != order.end(); ++rule) {
+        rest.push_back(std::move(rules[*rule]));
+      }
+      set_rule_list(std::move(rest));
+    }
+    return inlined;
+  }
+
+  // merges the generated helpers with the same rules, as the `(',' NUM)?` written in two
+  // places; a helper stands for itself in its own rules, so the loops of `x*` merge too.
+  // the helpers make no node, and a merged one is nullable on the lookaheads that either
+  // was, which only conflict where one of them did already.
+  bool merge_helpers(void) {
+    const token_id self_id = static_cast<token_id>(-1);
+    rule_list_type rules = rule_list();
+
+    bool merged = false;
+    bool changed = true;
+    while (changed) {
+      changed = false;
+      std::vector<token_id> helpers{};
+      std::unordered_map<token_id, std::vector<std::vector<token_id>>> bodies{};
+      for (auto&& rule = rules.begin(); rule != rules.end(); ++rule) {
+        const std::string& name = id_to_token[rule->first];
+        if (name.back() != ']' && name.back() != '/') {
+          continue;
+        }
+        if (bodies.find(rule->first) == bodies.end()) {
+          helpers.push_back(rule->first);
+        }
+        std::vector<token_id> body = rule->second;
+        std::replace(body.begin(), body.end(), rule->first, self_id);
+        bodies[rule->first].push_back(std::move(body));
+      }
+
+      std::map<std::vector<std::vector<token_id>>, token_id> helper_of{};
+      std::unordered_map<token_id, token_id> replaced{};
+      for (auto&& helper = helpers.begin(); helper != helpers.end(); ++helper) {
+        std::vector<std::vector<token_id>>& key = bodies[*helper];
+        // a counter merges only with one of the same counts.
+        auto&& repeat = work->repeats.find(*helper);
+        if (repeat != work->repeats.end()) {
+          key.push_back(std::vector<token_id>{self_id, repeat->second.first, repeat->second.second});
+        }
+        auto&& it = helper_of.insert(std::make_pair(key, *helper)).first;
+        if (it->second != *helper) {
+          replaced[*helper] = it->second;
+        }
+      }
+      if (replaced.empty()) {
+        break;
+      }
+
+      rule_list_type rest{};
+      for (auto&& rule = rules.begin(); rule != rules.end(); ++rule) {
+        if (replaced.find(rule->first) != replaced.end()) {
+          continue;
+        }
+        for (auto&& symbol = rule->second.begin(); symbol != rule->second.end(); ++symbol) {
+          auto&& it = replaced.find(*symbol);
+          if (it != replaced.end()) {
+            *symbol = it->second;
+          }
+        }
+        rest.push_back(std::move(*rule));
+      }
+      for (auto&& it = replaced.begin(); it != replaced.end(); ++it) {
+        work->nts.erase(it->first);
+        work->repeats.erase(it->first);
+      }
+      rules = std::move(rest);
+      changed = true;
+      merged = true;
+    }
+
+    if (merged) {
+      set_rule_list(std::move(rules));
+    }
+    return merged;
+  }
+
+  // drops the nonterms the start symbol never reaches, with the rules, character classes
+  // and literals only they use; so go :ws: and :ws*: when no `,` is written. :@: stays,
+  // as the parser always has a case for it.
+  bool prune_symbols(void) {
+    std::unordered_map<token_id, std::vector<rule_id>> rules_of{};
+    for (rule_id rule_id = 0; rule_id < work->rules.size(); ++rule_id) {
+      rules_of[work->rules.head(rule_id)].push_back(rule_id);
+    }
+    token_set_type reached{get_id("^"), get_id(":@:")};
+    std::vector<token_id> queue(reached.begin(), reached.end());
+    while (!queue.empty()) {
+      token_id nts_id = queue.back();
+      queue.pop_back();
+      for (auto&& rid = rules_of[nts_id].begin(); rid != rules_of[nts_id].end(); ++rid) {
+        auto&& body = work->rules.body(*rid);
+        for (auto&& symbol = body.begin(); symbol != body.end(); ++symbol) {
+          if (reached.insert(*symbol).second && work->nts.find(*symbol) != work->nts.end()) {
+            queue.push_back(*symbol);
+          }
+        }
+      }
+    }
+
+    bool pruned = false;
+    rule_list_type rules{};
+    for (auto&& rule : rule_list()) {
+      if (reached.find(rule.first) == reached.end()) {
+        pruned = true;
+      } else {
+        rules.push_back(std::move(rule));
+      }
+    }
+    for (auto&& it = work->nts.begin(); it != work->nts.end();) {
+      if (reached.find(*it) == reached.end()) {
+        work->repeats.erase(*it);
+        it = work->nts.erase(it);
+        pruned = true;
+      } else {
+        ++it;
+      }
+    }
+    for (auto&& it = work->ts.begin(); it != work->ts.end();) {
+      bool unused = reached.find(*it) == reached.end();
+      if (unused && work->classes.find(*it) != work->classes.end()) {
+        work->classes.erase(*it);
+      } else if (unused && work->literals.find(*it) != work->literals.end()) {
+        work->literals.erase(*it);
+      } else {
+        ++it;
+        continue;
+      }
+      it = work->ts.erase(it);
+      pruned = true;
+    }
+
+    if (pruned) {
+      set_rule_list(std::move(rules));
+    }
+    return pruned;
+  }
+
+  // numbers the nonterms and the terminals densely, in the order of their ids, as the rows
+  // and the columns of the table, and lists the rules of each nonterm by its row; the
+  // passes below index vectors with them instead of hashing ids.
+  bool number_symbols(void) {
+    if (work->rules.size() > table_type::max_rules) {
+      put_error();
+      std::cout << "too many rules for the table ("
+                << work->rules.size()
+                << ", "
+                << table_type::max_rules
+                << " at most)."
+                << std::endl;
+      return false;
+    }
+
+    token_id did = get_id("$");
+    table_type& ll1_table = work->table;
+    ll1_table.nonterms.clear();
+    ll1_table.terms.clear();
+    ll1_table.row_of.assign(token_to_id.size(), table_type::npos);
+    ll1_table.column_of.assign(token_to_id.size(), table_type::npos);
+    for (token_id id = 0; id < token_to_id.size(); ++id) {
+      if (work->nts.find(id) != work->nts.end()) {
+        ll1_table.row_of[id] = ll1_table.nonterms.size();
+        ll1_table.nonterms.push_back(id);
+      } else if (id == did || work->ts.find(id) != work->ts.end()) {
+        ll1_table.column_of[id] = ll1_table.terms.size();
+        ll1_table.terms.push_back(id);
+      }
+    }
+    ll1_table.cells.assign(ll1_table.nonterms.size() * ll1_table.terms.size(),
+                           static_cast<std::uint16_t>(work->rules.size()));
+
+    std::size_t rows = ll1_table.nonterms.size();
+    work->rules_of_nts_begins.assign(rows + 1, 0);
+    for (rule_id rule_id = 0; rule_id < work->rules.size(); ++rule_id) {
+      work->rules_of_nts_begins[ll1_table.row(work->rules.head(rule_id)) + 1] += 1;
+    }
+    for (std::size_t row = 0; row < rows; ++row) {
+      work->rules_of_nts_begins[row + 1] += work->rules_of_nts_begins[row];
+    }
+    std::vector<std::size_t> next(work->rules_of_nts_begins.begin(),
+                                  work->rules_of_nts_begins.end() - 1);
+    work->rules_of_nts.assign(work->rules.size(), 0);
+    for (rule_id rule_id = 0; rule_id < work->rules.size(); ++rule_id) {
+      work->rules_of_nts[next[ll1_table.row(work->rules.head(rule_id))]++] = rule_id;
+    }
+    return true;
+  }
+
+  // the strongly connected components of a graph, numbered in the order Tarjan's algorithm
+  // closes them, so that a component comes after every component it reaches. the edges of
+  // node n are edges[begins[n]] .. edges[begins[n + 1] - 1]; returns the number of the
+  // components.
+  static std::size_t find_components(const std::vector<std::size_t>& begins,
+                                     const std::vector<std::size_t>& edges,
+                                     std::vector<std::size_t>* component_of) {
+    const std::size_t unvisited = static_cast<std::size_t>(-1);
+    std::size_t nodes = begins.size() - 1;
+    std::vector<std::size_t> index(nodes, unvisited), low(nodes, 0);
+    std::vector<bool> on_stack(nodes, false);
+    std::vector<std::size_t> stack{};
+    // the nodes being visited, with the next of their edges to follow.
+    std::vector<std::pair<std::size_t, std::size_t>> path{};
+    std::size_t next_index = 0;
+    std::size_t components = 0;
+    component_of->assign(nodes, 0);
+    for (std::size_t root = 0; root < nodes; ++root) {
+      if (index[root] != unvisited) {
+        continue;
+      }
+      index[root] = low[root] = next_index++;
+      stack.push_back(root);
+      on_stack[root] = true;
+      path.push_back(std::make_pair(root, begins[root]));
+      while (!path.empty()) {
+        std::size_t node = path.back().first;
+        if (path.back().second < begins[node + 1]) {
+          std::size_t next = edges[path.back().second++];
+          if (index[next] == unvisited) {
+            index[next] = low[next] = next_index++;
+            stack.push_back(next);
+            on_stack[next] = true;
+            path.push_back(std::make_pair(next, begins[next]));
+          } else if (on_stack[next]) {
+            low[node] = std::min(low[node], index[next]);
+          }
+          continue;
+        }
+        path.pop_back();
+        if (low[node] == index[node]) {
+          std::size_t member;
+          do {
+            member = stack.back();
+            stack.pop_back();
+            on_stack[member] = false;
+            (*component_of)[member] = components;
+          } while (member != node);
+          components += 1;
+        }
+        if (!path.empty()) {
+          low[path.back().first] = std::min(low[path.back().first], low[node]);
+        }
+      }
+    }
+    return components;
+  }
+
+  // the members of each component, components[begins[c]] .. components[begins[c + 1] - 1].
+  static void list_components(const std::vector<std::size_t>& component_of,
+                              std::size_t components,
+                              std::vector<std::size_t>* begins,
+                              std::vector<std::size_t>* members) {
+    begins->assign(components + 1, 0);
+    for (auto&& component : component_of) {
+      (*begins)[component + 1] += 1;
+    }
+    for (std::size_t component = 0; component < components; ++component) {
+      (*begins)[component + 1] += (*begins)[component];
+    }
+    std::vector<std::size_t> next(begins->begin(), begins->end() - 1);
+    members->assign(component_of.size(), 0);
+    for (std::size_t node = 0; node < component_of.size(); ++node) {
+      (*members)[next[component_of[node]]++] = node;
+    }
+    return;
+  }
+
+  // the components by level, levels[begins[l]] .. levels[begins[l + 1] - 1]; a component
+  // reaches only the levels below its own, so the components of one level can be worked
+  // on at once.
+  static void level_components(const std::vector<std::size_t>& edge_begins,
+                               const std::vector<std::size_t>& edges,
+                               const std::vector<std::size_t>& component_of,
+                               const std::vector<std::size_t>& member_begins,
+                               const std::vector<std::size_t>& members,
+                               std::vector<std::size_t>* begins,
+                               std::vector<std::size_t>* levels) {
+    std::size_t components = member_begins.size() - 1;
+    std::vector<std::size_t> level_of(components, 0);
+    std::size_t level_count = 0;
+    for (std::size_t component = 0; component < components; ++component) {
+      for (std::size_t member = member_begins[component];
+                       member < member_begins[component + 1];
+                       ++member) {
+        std::size_t node = members[member];
+        for (std::size_t edge = edge_begins[node]; edge < edge_begins[node + 1]; ++edge) {
+          std::size_t next = component_of[edges[edge]];
+          if (next != component) {
+            level_of[component] = std::max(level_of[component], level_of[next] + 1);
+          }
+        }
+      }
+      level_count = std::max(level_count, level_of[component] + 1);
+    }
+    list_components(level_of, level_count, begins, levels);
+    return;
+  }
+
+  // finds the nullable nonterms first, counting down the symbols each rule still waits
+  // for; then FIRST flows over the graph of the rules and the nonterms their nullable
+  // prefixes reach, a component at a time. a cycle there is a left recursion, and its
+  // rules and the rules reaching it fail.
+  bool build_first_set(void) {
+    const table_type& ll1_table = work->table;
+    std::size_t rules = work->rules.size();
+    std::size_t rows = ll1_table.nonterms.size();
+
+    // the uses of each nonterm in the bodies, by row.
+    std::vector<std::size_t> use_begins(rows + 1, 0);
+    std::vector<rule_id> uses{};
+    std::vector<std::size_t> waiting(rules, 0);
+    for (rule_id rid = 0; rid < rules; ++rid) {
+      auto&& body = work->rules.body(rid);
+      waiting[rid] = body.size();
+      for (auto&& symbol : body) {
+        if (!ll1_table.has_row(symbol)) {
+          // a terminal is never waited out.
+          waiting[rid] = table_type::npos;
+          break;
+        }
+      }
+      if (waiting[rid] == table_type::npos) {
+        continue;
+      }
+      for (auto&& symbol : body) {
+        use_begins[ll1_table.row(symbol) + 1] += 1;
+      }
+    }
+    for (std::size_t row = 0; row < rows; ++row) {
+      use_begins[row + 1] += use_begins[row];
+    }
+    uses.assign(use_begins[rows], 0);
+    {
+      std::vector<std::size_t> next(use_begins.begin(), use_begins.end() - 1);
+      for (rule_id rid = 0; rid < rules; ++rid) {
+        if (waiting[rid] == table_type::npos) {
+          continue;
+        }
+        for (auto&& symbol : work->rules.body(rid)) {
+          uses[next[ll1_table.row(symbol)]++] = rid;
+        }
+      }
+    }
+
+    work->nullable.assign(rules, false);
+    work->nullable_nts.assign(rows, false);
+    std::vector<std::size_t> queue{};
+    auto&& make_nullable = [&](rule_id rid) {
+      work->nullable[rid] = true;
+      std::size_t row = ll1_table.row(work->rules.head(rid));
+      if (!work->nullable_nts[row]) {
+        work->nullable_nts[row] = true;
+        queue.push_back(row);
+      }
+    };
+    for (rule_id rid = 0; rid < rules; ++rid) {
+      if (waiting[rid] == 0) {
+        make_nullable(rid);
+      }
+    }
+    while (!queue.empty()) {
+      std::size_t row = queue.back();
+      queue.pop_back();
+      for (std::size_t use = use_begins[row]; use < use_begins[row + 1]; ++use) {
+        if (--waiting[uses[use]] == 0) {
+          make_nullable(uses[use]);
+        }
+      }
+    }
+
+    // the rules are nodes 0 .. rules - 1 and the nonterms the nodes after them; a nonterm
+    // leads to its rules, and a rule to the nonterms of its nullable prefix.
+    std::vector<std::size_t> begins{0};
+    std::vector<std::size_t> edges{};
+    for (rule_id rid = 0; rid < rules; ++rid) {
+      for (auto&& symbol : work->rules.body(rid)) {
+        std::size_t row = ll1_table.row(symbol);
+        if (row == table_type::npos) {
+          break;
+        }
+        edges.push_back(rules + row);
+        if (!work->nullable_nts[row]) {
+          break;
+        }
+      }
+      begins.push_back(edges.size());
+    }
+    for (std::size_t row = 0; row < rows; ++row) {
+      for (std::size_t rule = work->rules_of_nts_begins[row];
+                       rule < work->rules_of_nts_begins[row + 1];
+                       ++rule) {
+        edges.push_back(work->rules_of_nts[rule]);
+      }
+      begins.push_back(edges.size());
+    }
+
+    std::vector<std::size_t> component_of{};
+    std::size_t components = find_components(begins, edges, &component_of);
+    std::vector<std::size_t> member_begins{}, members{};
+    list_components(component_of, components, &member_begins, &members);
+
+    std::vector<std::size_t> level_begins{}, levels{};
+    level_components(begins, edges, component_of, member_begins, members, &level_begins, &levels);
+
+    work->first.assign(rules, ll1_table.terms.size());
+    work->first_of_nts.assign(rows, ll1_table.terms.size());
+    auto&& first_of = [&](std::size_t node) {
+      return node < rules ? work->first[node] : work->first_of_nts[node - rules];
+    };
+    std::vector<char> left_recursive(components, false);
+    auto&& first_of_component = [&](std::size_t component) {
+      column_sets_type component_first{};
+      component_first.assign(1, ll1_table.terms.size());
+      bool reaches_cycle = member_begins[component + 1] - member_begins[component] > 1;
+      for (std::size_t member = member_begins[component];
+                       member < member_begins[component + 1];
+                       ++member) {
+        std::size_t node = members[member];
+        if (node < rules) {
+          // the terminal that ends the nullable prefix, if any.
+          for (auto&& symbol : work->rules.body(node)) {
+            std::size_t row = ll1_table.row(symbol);
+            if (row == table_type::npos) {
+              component_first.insert(0, ll1_table.column(symbol));
+              break;
+            } else if (!work->nullable_nts[row]) {
+              break;
             }
           }
         }
-        if (has_epsilon) {
-          if (work->first[target_rule_id].find(eid) == work->first[target_rule_id].end()) {
-            updated = true;
-            work->first[target_rule_id].insert(eid);
+        for (std::size_t edge = begins[node]; edge < begins[node + 1]; ++edge) {
+          std::size_t next = edges[edge];
+          if (component_of[next] != component) {
+            component_first.unite(0, first_of(next));
+            reaches_cycle |= left_recursive[component_of[next]] != 0;
           }
         }
-        if (!need_to_update) {
-          complete_to_build[target_rule_id] = true;
+      }
+      left_recursive[component] = reaches_cycle;
+      for (std::size_t member = member_begins[component];
+                       member < member_begins[component + 1];
+                       ++member) {
+        std::size_t node = members[member];
+        if (node < rules) {
+          work->first.unite(node, component_first[0]);
+        } else {
+          work->first_of_nts.unite(node - rules, component_first[0]);
         }
       }
+    };
+    for (std::size_t level = 0; level + 1 < level_begins.size(); ++level) {
+      pool->run(level_begins[level + 1] - level_begins[level], [&](std::size_t i) {
+        first_of_component(levels[level_begins[level] + i]);
+      });
     }
 
     if (verbose) {
       std::cout << "first:" << std::endl;
-      for (rule_id rule_id = 0; rule_id < work->rules.size(); ++rule_id) {
+      for (rule_id rule_id = 0; rule_id < rules; ++rule_id) {
         std::cout << "  rule " << static_cast<int>(rule_id) << ": ";
-        std::cout << id_to_token[work->rules[rule_id].first] << " ->";
-        for (auto&& first = work->first[rule_id].begin();
-                    first != work->first[rule_id].end();
-                    ++first) {
-          std::cout << " " << id_to_token[*first];
+        std::cout << id_to_token[work->rules.head(rule_id)] << " ->";
+        for (auto&& column : work->first.columns(rule_id)) {
+          std::cout << " " << id_to_token[ll1_table.terms[column]];
+        }
+        if (work->nullable[rule_id]) {
+          std::cout << " <epsilon>";
         }
-        if (!complete_to_build[rule_id]) {
+        if (left_recursive[component_of[rule_id]] != 0) {
           std::cout << " : ";
           put_bad();
           std::cout << std::endl;
@@ -2072,8 +2852,8 @@ class context {
       std::cout << std::endl;
     }
 
-    for (auto&& it = work->rules.begin(); it != work->rules.end(); ++it) {
-      if (!complete_to_build[it->first]) {
+    for (rule_id rule_id = 0; rule_id < rules; ++rule_id) {
+      if (left_recursive[component_of[rule_id]] != 0) {
         return false;
       }
     }
@@ -2081,260 +2861,242 @@ class context {
     return true;
   }
 
-  bool build_follow_set(void) {
-    token_id eid = get_id("<epsilon>");
+  // a nonterm followed by the rest of a body takes the FIRST of the rest, which a right to
+  // left walk over the body builds once; a nonterm the rest of whose body is nullable also
+  // takes the FOLLOW of the head. the nonterms that take each other's FOLLOW in a cycle
+  // share one, so FOLLOW flows over the components of that graph.
+  void build_follow_set(void) {
     token_id did = get_id("$");
-
-    std::unordered_map<token_id, bool> complete_to_build{};
-    std::unordered_map<token_id, bool> need_complete{};
-    for (auto&& it = work->nts.begin(); it != work->nts.end(); ++it) {
-      token_id target_token_id = *it;
-      work->follow.insert(std::make_pair(target_token_id, std::unordered_set<token_id>()));
-      complete_to_build[target_token_id] = false;
-      bool has_epsilon = false;
-      for (auto&& rule = work->rules_of_nts[target_token_id].begin();
-                  rule != work->rules_of_nts[target_token_id].end();
-                  ++rule) {
-        rule_id rule_id = *rule;
-        if (work->first[rule_id].find(eid) != work->first[rule_id].end()) {
-          has_epsilon = true;
-          break;
+    const table_type& ll1_table = work->table;
+    std::size_t rows = ll1_table.nonterms.size();
+
+    work->follow.assign(rows, ll1_table.terms.size());
+    work->follow.insert(ll1_table.row(get_id("^")), ll1_table.column(did));
+
+    std::vector<std::pair<std::size_t, std::size_t>> takes{};
+    column_sets_type rest{};
+    rest.assign(1, ll1_table.terms.size());
+    for (rule_id rid = 0; rid < work->rules.size(); ++rid) {
+      std::size_t head_row = ll1_table.row(work->rules.head(rid));
+      auto&& body = work->rules.body(rid);
+      rest.clear(0);
+      bool rest_nullable = true;
+      for (auto&& symbol = body.rbegin(); symbol != body.rend(); ++symbol) {
+        std::size_t row = ll1_table.row(*symbol);
+        if (row == table_type::npos) {
+          rest.clear(0);
+          rest.insert(0, ll1_table.column(*symbol));
+          rest_nullable = false;
+          continue;
+        }
+        work->follow.unite(row, rest[0]);
+        if (rest_nullable && row != head_row) {
+          takes.push_back(std::make_pair(row, head_row));
+        }
+        if (!work->nullable_nts[row]) {
+          rest.clear(0);
+          rest_nullable = false;
         }
+        rest.unite(0, work->first_of_nts[row]);
       }
-      if (has_epsilon) {
-        need_complete[target_token_id] = true;
-      } else {
-        need_complete[target_token_id] = false;
+    }
+
+    std::vector<std::size_t> begins(rows + 1, 0);
+    for (auto&& take : takes) {
+      begins[take.first + 1] += 1;
+    }
+    for (std::size_t row = 0; row < rows; ++row) {
+      begins[row + 1] += begins[row];
+    }
+    std::vector<std::size_t> edges(takes.size(), 0);
+    {
+      std::vector<std::size_t> next(begins.begin(), begins.end() - 1);
+      for (auto&& take : takes) {
+        edges[next[take.first]++] = take.second;
       }
     }
 
-    token_id start_symbol_id = get_id("^");
-    work->follow[start_symbol_id].insert(did);
-
-    bool updated = true;
-    while (updated) {
-      updated = false;
-      for (auto&& it = work->nts.begin(); it != work->nts.end(); ++it) {
-        token_id target_token_id = *it;
-        if (complete_to_build[target_token_id]) {
-          continue;
-        }
-        bool need_to_update = false;
-        for (auto&& rule = work->rules.begin(); rule != work->rules.end(); ++rule) {
-          token_id depending_token_id = rule->second.first;
-          for (std::size_t body_index = 0;
-                           body_index < rule->second.second.size();
-                           ++body_index) {
-            if (rule->second.second[body_index] == target_token_id) {
-              std::unordered_set<token_id> follow_first{};
-              bool has_epsilon = true;
-              for (std::size_t follow_index = body_index + 1;
-                               follow_index < rule->second.second.size() && has_epsilon;
-                               ++follow_index) {
-                has_epsilon = false;
-                token_id follow_token_id = rule->second.second[follow_index];
-                if (work->ts.find(follow_token_id) == work->ts.end()) {
-                  for (auto&& follow_rule = work->rules_of_nts[follow_token_id].begin();
-                              follow_rule != work->rules_of_nts[follow_token_id].end();
-                              ++follow_rule) {
-                    rule_id follow_rule_id = *follow_rule;
-                    for (auto&& first = work->first[follow_rule_id].begin();
-                                first != work->first[follow_rule_id].end();
-                                ++first) {
-                      if (*first == eid) {
-                        has_epsilon = true;
-                      } else if (follow_first.find(*first) == follow_first.end()) {
-                        follow_first.insert(*first);
-                      }
-                    }
-                  }
-                } else if (follow_first.find(follow_token_id) == follow_first.end()) {
-                  follow_first.insert(follow_token_id);
-                }
-              }
-              for (auto&& first = follow_first.begin(); first != follow_first.end(); ++first) {
-                if (work->follow[target_token_id].find(*first) ==
-                    work->follow[target_token_id].end()) {
-                  updated = true;
-                  work->follow[target_token_id].insert(*first);
-                }
-              }
-              if (has_epsilon && depending_token_id != target_token_id) {
-                if (!complete_to_build[depending_token_id]) {
-                  need_to_update = true;
-                } else {
-                  for (auto&& follow = work->follow[depending_token_id].begin();
-                              follow != work->follow[depending_token_id].end();
-                              ++follow) {
-                    if (work->follow[target_token_id].find(*follow) ==
-                        work->follow[target_token_id].end()) {
-                      updated = true;
-                      work->follow[target_token_id].insert(*follow);
-                    }
-                  }
-                }
-              }
-            }
+    std::vector<std::size_t> component_of{};
+    std::size_t components = find_components(begins, edges, &component_of);
+    std::vector<std::size_t> member_begins{}, members{};
+    list_components(component_of, components, &member_begins, &members);
+
+    std::vector<std::size_t> level_begins{}, levels{};
+    level_components(begins, edges, component_of, member_begins, members, &level_begins, &levels);
+
+    auto&& follow_of_component = [&](std::size_t component) {
+      column_sets_type component_follow{};
+      component_follow.assign(1, ll1_table.terms.size());
+      for (std::size_t member = member_begins[component];
+                       member < member_begins[component + 1];
+                       ++member) {
+        std::size_t row = members[member];
+        component_follow.unite(0, work->follow[row]);
+        for (std::size_t edge = begins[row]; edge < begins[row + 1]; ++edge) {
+          if (component_of[edges[edge]] != component) {
+            component_follow.unite(0, work->follow[edges[edge]]);
           }
         }
-        if (!need_to_update) {
-          updated = true;
-          complete_to_build[target_token_id] = true;
-        }
       }
+      for (std::size_t member = member_begins[component];
+                       member < member_begins[component + 1];
+                       ++member) {
+        work->follow.unite(members[member], component_follow[0]);
+      }
+    };
+    for (std::size_t level = 0; level + 1 < level_begins.size(); ++level) {
+      pool->run(level_begins[level + 1] - level_begins[level], [&](std::size_t i) {
+        follow_of_component(levels[level_begins[level] + i]);
+      });
     }
 
     if (verbose) {
       std::cout << "follow:" << std::endl;
-      std::unordered_set<token_id> nts{};
+      std::vector<bool> put(rows, false);
       for (rule_id rule_id = 0; rule_id < work->rules.size(); ++rule_id) {
-        token_id id = work->rules[rule_id].first;
-        if (nts.find(id) != nts.end()) {
+        token_id id = work->rules.head(rule_id);
+        std::size_t row = ll1_table.row(id);
+        if (put[row]) {
           continue;
         }
-        nts.insert(id);
+        put[row] = true;
         std::cout << "  " << id_to_token[id] << " ->";
-        for (auto&& follow = work->follow[id].begin();
-                    follow != work->follow[id].end();
-                    ++follow) {
-          std::cout << " " << id_to_token[*follow];
-        }
-        if (!complete_to_build[id] && need_complete[id]) {
-          std::cout << " : ";
-          put_bad();
-          std::cout << std::endl;
-        } else {
-          std::cout << " : ";
-          put_ok();
-          std::cout << std::endl;
+        for (auto&& column : work->follow.columns(row)) {
+          std::cout << " " << id_to_token[ll1_table.terms[column]];
         }
+        std::cout << std::endl;
       }
       std::cout << std::endl;
     }
 
-    for (auto&& it = work->nts.begin(); it != work->nts.end(); ++it) {
-      if (!complete_to_build[*it] && need_complete[*it]) {
-        return false;
+    return;
+  }
+
+  // the columns of the table each column spreads over; a character class spreads over its
+  // bytes, and a literal over the column of its first byte.
+  std::vector<std::vector<std::size_t>> spread_columns(void) {
+    const table_type& ll1_table = work->table;
+    std::vector<std::vector<std::size_t>> spread(ll1_table.terms.size());
+    for (std::size_t column = 0; column < ll1_table.terms.size(); ++column) {
+      token_id id = ll1_table.terms[column];
+      auto&& literal = work->literals.find(id);
+      auto&& char_class = work->classes.find(id);
+      if (literal != work->literals.end()) {
+        token_id first_byte = get_id(byte_token_string(static_cast<unsigned char>(literal->second[0])));
+        spread[column].push_back(ll1_table.column(first_byte));
+      } else if (char_class != work->classes.end()) {
+        for (std::size_t c = 0; c < 256; ++c) {
+          if (char_class->second[c]) {
+            spread[column].push_back(ll1_table.column(get_id(byte_token_string(c))));
+          }
+        }
+      } else {
+        spread[column].push_back(column);
       }
     }
+    return spread;
+  }
 
-    return true;
+  std::vector<std::size_t> table_columns_of(const column_sets_type& sets,
+                                            std::size_t set,
+                                            const std::vector<std::vector<std::size_t>>& spread) {
+    column_sets_type columns{};
+    columns.assign(1, spread.size());
+    for (auto&& column : sets.columns(set)) {
+      for (auto&& spread_column : spread[column]) {
+        columns.insert(0, spread_column);
+      }
+    }
+    return columns.columns(0);
   }
 
+  // a rule only takes cells of the row of its head, so the rows fill independently; the
+  // bookings are put after, in the order of the rows.
   bool build_table(void) {
-    token_id eid = get_id("<epsilon>");
-    token_id did = get_id("$");
     rule_id empty_rule_id = work->rules.size();
     rule_id booked_rule_id = work->rules.size() + 1;
-
-    for (auto&& stack_token = work->nts.begin();
-                stack_token != work->nts.end();
-                ++stack_token) {
-      token_id stack_token_id = *stack_token;
-      work->table.insert(std::make_pair(stack_token_id,
-                                        std::unordered_map<token_id, rule_id>()));
-      for (auto&& input_token = work->ts.begin();
-                  input_token != work->ts.end();
-                  ++input_token) {
-        token_id input_token_id = *input_token;
-        work->table[stack_token_id][input_token_id] = empty_rule_id;
+    table_type& ll1_table = work->table;
+    std::size_t rows = ll1_table.nonterms.size();
+    std::vector<std::vector<std::size_t>> spread = spread_columns();
+
+    // a rule that found a cell taken by another, which it did not settle.
+    struct booking {
+      rule_id rid, old_rule_id;
+      std::size_t column;
+    };
+    std::vector<std::vector<booking>> bookings(rows);
+    std::vector<char> partial_booked_rows(rows, false);
+
+    auto&& fill_row = [&](std::size_t row) {
+      // a cell is empty until a rule takes it; a second rule books it.
+      auto&& take = [&](std::size_t column, rule_id rid) {
+        std::uint16_t& cell = ll1_table.cell(row, column);
+        if (cell == empty_rule_id) {
+          cell = static_cast<std::uint16_t>(rid);
+          return;
+        } else if (cell == rid) {
+          return;
+        }
+        rule_id old_rule_id = cell;
+        cell = static_cast<std::uint16_t>(booked_rule_id);
+        if (sure_partial_book && old_rule_id < empty_rule_id) {
+          if (work->nullable[rid]) {
+            partial_booked_rows[row] = true;
+            cell = static_cast<std::uint16_t>(old_rule_id);
+            return;
+          } else if (work->nullable[old_rule_id]) {
+            partial_booked_rows[row] = true;
+            cell = static_cast<std::uint16_t>(rid);
+            return;
+          }
+        }
+        bookings[row].push_back(booking{rid, old_rule_id, column});
+      };
+
+      token_id stack_token_id = ll1_table.nonterms[row];
+      // an exact count leaves its repetition by the counter, not by the lookahead.
+      auto&& repeat = work->repeats.find(stack_token_id);
+      bool exact_repeat = repeat != work->repeats.end()
+                          && repeat->second.first == repeat->second.second;
+
+      for (std::size_t rule = work->rules_of_nts_begins[row];
+                       rule < work->rules_of_nts_begins[row + 1];
+                       ++rule) {
+        rule_id rid = work->rules_of_nts[rule];
+        for (auto&& column : table_columns_of(work->first, rid, spread)) {
+          take(column, rid);
+        }
+        if (work->nullable[rid] && !exact_repeat) {
+          for (auto&& column : table_columns_of(work->follow, row, spread)) {
+            take(column, rid);
+          }
+        }
       }
-      work->table[stack_token_id][did] = empty_rule_id;
-    }
+    };
+    pool->run(rows, fill_row);
 
     bool booked = false;
     bool partial_booked = false;
-    for (auto&& it = work->first.begin(); it != work->first.end(); ++it) {
-      rule_id rid = it->first;
-      token_id stack_token_id = work->rules[rid].first;
-
-      if (work->ts.find(stack_token_id) == work->ts.end()) {
-        bool has_epsilon = false;
-        for (auto&& input_token = it->second.begin();
-                    input_token != it->second.end();
-                    ++input_token) {
-          token_id input_token_id = *input_token;
-          if (input_token_id == eid) {
-            has_epsilon = true;
-          } else if (work->table[stack_token_id][input_token_id] == empty_rule_id) {
-            work->table[stack_token_id][input_token_id] = rid;
-          } else {
-            bool booked_now = true;
-            rule_id old_rule_id = work->table[stack_token_id][input_token_id];
-            work->table[stack_token_id][input_token_id] = booked_rule_id;
-            if (sure_partial_book) {
-              if (work->first[rid].find(eid) != work->first[rid].end()) {
-                booked_now = false;
-                partial_booked = true;
-                work->table[stack_token_id][input_token_id] = old_rule_id;
-              } else if (work->first[old_rule_id].find(eid) !=
-                         work->first[old_rule_id].end()) {
-                booked_now = false;
-                partial_booked = true;
-                work->table[stack_token_id][input_token_id] = rid;
-              }
-            }
-            if (booked_now && verbose) {
-              put_warning();
-              std::cout << "booked on state "
-                        << id_to_token[stack_token_id]
-                        << " (rule "
-                        << static_cast<int>(rid)
-                        << " and rule "
-                        << static_cast<int>(old_rule_id)
-                        << ") with token "
-                        << id_to_token[input_token_id]
-                        << std::endl;
-            }
-            booked |= booked_now;
-          }
-        }
-
-        if (has_epsilon) {
-          for (auto&& input_token = work->follow[stack_token_id].begin();
-                      input_token != work->follow[stack_token_id].end();
-                      ++input_token) {
-            token_id input_token_id = *input_token;
-            if (work->table[stack_token_id][input_token_id] == empty_rule_id) {
-              work->table[stack_token_id][input_token_id] = rid;
-            } else if (work->table[stack_token_id][input_token_id] != rid) {
-              bool booked_now = true;
-              rule_id old_rule_id = work->table[stack_token_id][input_token_id];
-              work->table[stack_token_id][input_token_id] = booked_rule_id;
-              if (sure_partial_book) {
-                if (work->first[rid].find(eid) != work->first[rid].end()) {
-                  booked_now = false;
-                  partial_booked = true;
-                  work->table[stack_token_id][input_token_id] = old_rule_id;
-                } else if (work->first[old_rule_id].find(eid) !=
-                           work->first[old_rule_id].end()) {
-                  booked_now = false;
-                  partial_booked = true;
-                  work->table[stack_token_id][input_token_id] = rid;
-                }
-              }
-              if (booked_now && verbose) {
-                put_warning();
-                std::cout << "booked on state "
-                          << id_to_token[stack_token_id]
-                          << " (rule "
-                          << static_cast<int>(rid)
-                          << " and rule "
-                          << static_cast<int>(old_rule_id)
-                          << ") with token "
-                          << id_to_token[input_token_id]
-                          << std::endl;
-              }
-              booked |= booked_now;
-            }
-          }
+    for (std::size_t row = 0; row < rows; ++row) {
+      partial_booked |= partial_booked_rows[row] != 0;
+      for (auto&& it = bookings[row].begin(); it != bookings[row].end(); ++it) {
+        booked = true;
+        if (verbose) {
+          put_warning();
+          std::cout << "booked on state "
+                    << id_to_token[ll1_table.nonterms[row]]
+                    << " (rule "
+                    << static_cast<int>(it->rid)
+                    << " and rule "
+                    << static_cast<int>(it->old_rule_id)
+                    << ") with token "
+                    << id_to_token[ll1_table.terms[it->column]]
+                    << std::endl;
         }
       }
     }
 
     if (verbose || table) {
-      work->ts.insert(did);
-
       std::vector<std::vector<std::string>> table_raw{};
       std::vector<std::vector<bool>> table_colored{};
       std::vector<token_id> table_header_id{};
@@ -2345,8 +3107,8 @@ class context {
       table_colored.emplace_back(std::vector<bool>());
       table_colored.back().push_back(false);
       table_header_id.emplace_back(get_id("<invalid>"));
-      for (auto&& stack_token = work->nts.begin();
-                  stack_token != work->nts.end();
+      for (auto&& stack_token = ll1_table.nonterms.begin();
+                  stack_token != ll1_table.nonterms.end();
                   ++stack_token) {
         token_id stack_token_id = *stack_token;
         table_raw.back().push_back(id_to_token[stack_token_id]);
@@ -2356,9 +3118,14 @@ class context {
 
       // rest rows
       std::set<std::string> ts{};
-      for (auto&& input_token = work->ts.begin();
-                  input_token != work->ts.end();
+      for (auto&& input_token = ll1_table.terms.begin();
+                  input_token != ll1_table.terms.end();
                   ++input_token) {
+        if (work->classes.find(*input_token) != work->classes.end()) {
+          continue;
+        } else if (work->literals.find(*input_token) != work->literals.end()) {
+          continue;
+        }
         ts.insert(id_to_token[*input_token]);
       }
       for (auto&& input_token = ts.begin(); input_token != ts.end(); ++input_token) {
@@ -2369,7 +3136,7 @@ class context {
         table_colored.back().push_back(false);
         for (std::size_t column = 1; column < table_header_id.size(); ++column) {
           token_id stack_token_id = table_header_id[column];
-          rule_id rule_id = work->table[stack_token_id][input_token_id];
+          rule_id rule_id = ll1_table.at(stack_token_id, input_token_id);
           if (rule_id == empty_rule_id) {
             table_raw.back().emplace_back("-");
             table_colored.back().push_back(false);
@@ -2515,6 +3282,75 @@ class context {
     }
   }
 
+  // the nonterms defined with '=' that derive nothing but bytes, character classes and
+  // literals, as ID or NUM; the start symbol keeps its structure.
+  void build_lexemes(void) {
+    token_set_type bytes{};
+    for (std::size_t c = 0; c < 256; ++c) {
+      auto&& it = token_to_id.find(byte_token_string(c));
+      if (it != token_to_id.end()) {
+        bytes.insert(it->second);
+      }
+    }
+
+    token_id start_symbol_id = get_id("^");
+    token_set_type candidates{};
+    for (auto&& it = work->nts.begin(); it != work->nts.end(); ++it) {
+      const std::string& name = id_to_token[*it];
+      if (work->plain_nts.find(*it) != work->plain_nts.end()
+          || name.back() == ']' || name.back() == '/') {
+        candidates.insert(*it);
+      }
+    }
+    for (rule_id rule_id = 0; rule_id < work->rules.size(); ++rule_id) {
+      if (work->rules.head(rule_id) == start_symbol_id) {
+        for (auto&& symbol : work->rules.body(rule_id)) {
+          candidates.erase(symbol);
+        }
+      }
+    }
+
+    // drops the nonterms that reach anything else until nothing changes.
+    bool changed = true;
+    while (changed) {
+      changed = false;
+      for (rule_id rule_id = 0; rule_id < work->rules.size(); ++rule_id) {
+        token_id head_id = work->rules.head(rule_id);
+        if (candidates.find(head_id) == candidates.end()) {
+          continue;
+        }
+        for (auto&& symbol : work->rules.body(rule_id)) {
+          if (candidates.find(symbol) == candidates.end()
+              && bytes.find(symbol) == bytes.end()
+              && work->classes.find(symbol) == work->classes.end()
+              && work->literals.find(symbol) == work->literals.end()) {
+            candidates.erase(head_id);
+            changed = true;
+            break;
+          }
+        }
+      }
+    }
+
+    // the generated ones make no node to collapse.
+    work->lexemes.clear();
+    for (auto&& it = candidates.begin(); it != candidates.end(); ++it) {
+      const std::string& name = id_to_token[*it];
+      if (name.back() != ']' && name.back() != '/') {
+        work->lexemes.insert(*it);
+      }
+    }
+
+    if (verbose) {
+      std::cout << "lexemes:";
+      for (auto&& it = work->lexemes.begin(); it != work->lexemes.end(); ++it) {
+        std::cout << " " << id_to_token[*it];
+      }
+      std::cout << std::endl << std::endl;
+    }
+    return;
+  }
+
   bool check(void) {
     if (!parsed) {
       parsed_input = parse();
@@ -2530,21 +3366,30 @@ class context {
       checked = true;
       return false;
     }
+    bool optimized = inline_helpers();
+    optimized |= merge_helpers();
+    optimized |= prune_symbols();
+    if (optimized && verbose) {
+      std::cout << "rule-list after inlining, merging and pruning:" << std::endl;
+      put_rule_list(work);
+    }
 
-    if (!build_first_set()) {
-      put_error();
-      std::cout << "building FIRST set failed." << std::endl;
+    // more threads than the cores only take turns; with no count known, one does it all.
+    pool = std::make_unique<thread_pool>(std::min<std::size_t>(jobs, std::thread::hardware_concurrency()));
+    if (!number_symbols()) {
       checked = true;
       return false;
     }
 
-    if (!build_follow_set()) {
+    if (!build_first_set()) {
       put_error();
-      std::cout << "building FOLLOW set failed." << std::endl;
+      std::cout << "building FIRST set failed." << std::endl;
       checked = true;
       return false;
     }
 
+    build_follow_set();
+
     if (!build_table()) {
       put_error();
       std::cout << "building TABLE failed." << std::endl;
@@ -2563,6 +3408,7 @@ class context {
     token_to_id.clear();
     id_to_token.clear();
     id_to_regexp_body.clear();
+    id_to_literal.clear();
     is = nullptr;
     parsed_input = nullptr;
     work = nullptr;
@@ -2573,6 +3419,19 @@ class context {
     table = false;
     sure_partial_book = false;
     width_limited = false;
+    arena = false;
+    mmap_file = false;
+    events = false;
+    validator = false;
+    flat_tree = false;
+    leaves = false;
+    scanners = false;
+    trivia = false;
+    literals = false;
+    jobs = 1;
+    pool = nullptr;
+    backend = codegen_backend::nested_switch;
+    table_layout = codegen_table_layout::automatic;
     ll1p = false;
     lr = 0;
     ln = 0;
@@ -2605,18 +3464,40 @@ class context {
       ll1p = is_ll1();
     }
     if (ll1p) {
+      if (leaves || scanners) {
+        build_lexemes();
+      }
+      codegen_options options{};
+      // the events build no tree, and the flat tree no nodes, to allocate.
+      options.arena = arena && !events && !flat_tree;
+      options.mmap_file = mmap_file;
+      options.events = events;
+      options.validator = validator;
+      options.flat_tree = flat_tree && !events;
+      // a scanner leaves no subtree behind.
+      options.leaves = leaves || scanners;
+      options.scanners = scanners;
+      options.trivia = trivia;
+      options.backend = backend;
+      options.table_layout = table_layout;
       ::generate_code(header,
                       ccfile,
                       get_id("^"),
                       get_id("$"),
                       get_id(":@:"),
                       get_id("<end-of-body>"),
+                      get_id(":ws*:"),
                       work->ts,
                       work->nts,
+                      work->classes,
+                      work->literals,
+                      work->repeats,
+                      work->lexemes,
                       id_to_token,
                       token_to_id,
                       work->rules,
-                      work->table);
+                      work->table,
+                      options);
     }
     return;
   }
@@ -2645,8 +3526,100 @@ class context {
     width_limited = true;
     return;
   }
+
+  void set_arena(void) {
+    arena = true;
+    return;
+  }
+
+  void set_mmap_file(void) {
+    mmap_file = true;
+    return;
+  }
+
+  void set_events(void) {
+    events = true;
+    return;
+  }
+
+  void set_validator(void) {
+    validator = true;
+    return;
+  }
+
+  void set_flat_tree(void) {
+    flat_tree = true;
+    return;
+  }
+
+  void set_leaves(void) {
+    leaves = true;
+    return;
+  }
+
+  void set_scanners(void) {
+    scanners = true;
+    return;
+  }
+
+  void set_trivia(void) {
+    trivia = true;
+    return;
+  }
+
+  void set_jobs(std::size_t jobs_) {
+    jobs = jobs_;
+    return;
+  }
+
+  void set_literals(void) {
+    literals = true;
+    return;
+  }
+
+  void set_backend(codegen_backend backend_, codegen_table_layout table_layout_) {
+    backend = backend_;
+    table_layout = table_layout_;
+    return;
+  }
 };
 
+static void put_usage(void) {
+  std::cout << "usage: ryx [OPTION]... [GRAMMAR]" << std::endl
+            << "reads GRAMMAR, or the standard input, and writes ryx_parse.h and ryx_parse.cc"
+            << std::endl
+            << "into the current directory if it is in the LL(1)." << std::endl
+            << "  -v  prints the sets, the rules and the table." << std::endl
+            << "  -q  prints no warnings." << std::endl
+            << "  -t  prints the table." << std::endl
+            << "  -p  settles a booked cell on the rule that is not nullable." << std::endl
+            << "  -w  prints the table in pieces 100 columns wide." << std::endl
+            << "  -a  allocates the tree from an arena that ryx_tree_free releases at once."
+            << std::endl
+            << "  -b switch|table|table-dense|table-comb" << std::endl
+            << "      generates nested switches, the default, or a driver over the LL(1) table;"
+            << std::endl
+            << "      table-dense and table-comb force its layout, table takes the smaller one."
+            << std::endl
+            << "  -m  adds ryx_parse_file, which parses a file mapped into memory." << std::endl
+            << "  -e  reports the parse through callbacks in place of making a tree." << std::endl
+            << "  -r  adds ryx_validate, which checks a buffer without allocating, on its own stack"
+            << std::endl
+            << "      or on one of the caller with ryx_validate_with_stack." << std::endl
+            << "  -f  makes the tree a flat array of nodes, with ryx_get_flat_tree and ryx_get_index."
+            << std::endl
+            << "  -l  makes each lexeme one leaf, with ryx_get_end_offset; -e reports it by ryx_on_lexeme."
+            << std::endl
+            << "  -d  implies -l, and scans each regular lexeme with a DFA." << std::endl
+            << "  -s  skips the whitespace of `,` in place; -e reports it by ryx_on_trivia."
+            << std::endl
+            << "  -k  matches each quoted string as one terminal." << std::endl
+            << "  -j N  runs the analysis and the table on N threads, at most one a core."
+            << std::endl
+            << "  -h  prints this usage." << std::endl;
+  return;
+}
+
 int main(int argc, char** argv) {
   auto c = std::make_unique<context>();
   std::ifstream file{};
@@ -2657,6 +3630,18 @@ int main(int argc, char** argv) {
   bool table = false;
   bool sure_partial_book = false;
   bool width_limited = false;
+  bool arena = false;
+  bool mmap_file = false;
+  bool events = false;
+  bool validator = false;
+  bool flat_tree = false;
+  bool leaves = false;
+  bool scanners = false;
+  bool trivia = false;
+  bool literals = false;
+  std::size_t jobs = 1;
+  codegen_backend backend = codegen_backend::nested_switch;
+  codegen_table_layout table_layout = codegen_table_layout::automatic;
   for (int i = 1; i < argc; ++i) {
     if (argv[i][0] == '-') {
       for (std::size_t j = 1; argv[i][j] != '\0'; ++j) {
@@ -2670,6 +3655,69 @@ int main(int argc, char** argv) {
           sure_partial_book = true;
         } else if (argv[i][j] == 'w') {
           width_limited = true;
+        } else if (argv[i][j] == 'a') {
+          arena = true;
+        } else if (argv[i][j] == 'm') {
+          mmap_file = true;
+        } else if (argv[i][j] == 'e') {
+          events = true;
+        } else if (argv[i][j] == 'r') {
+          validator = true;
+        } else if (argv[i][j] == 'f') {
+          flat_tree = true;
+        } else if (argv[i][j] == 'l') {
+          leaves = true;
+        } else if (argv[i][j] == 'd') {
+          scanners = true;
+        } else if (argv[i][j] == 's') {
+          trivia = true;
+        } else if (argv[i][j] == 'k') {
+          literals = true;
+        } else if (argv[i][j] == 'b') {
+          // -b NAME or -bNAME; takes the rest of the argument.
+          const char* name = &argv[i][j + 1];
+          if (*name == '\0' && i + 1 < argc) {
+            name = argv[++i];
+          }
+          if (std::string(name) == "switch") {
+            backend = codegen_backend::nested_switch;
+          } else if (std::string(name) == "table") {
+            backend = codegen_backend::table;
+            table_layout = codegen_table_layout::automatic;
+          } else if (std::string(name) == "table-dense") {
+            backend = codegen_backend::table;
+            table_layout = codegen_table_layout::dense;
+          } else if (std::string(name) == "table-comb") {
+            backend = codegen_backend::table;
+            table_layout = codegen_table_layout::comb;
+          } else {
+            std::cout << BOLD RED FATAL RESET "unknown backend '" << name << "'" << std::endl;
+            put_usage();
+            return 1;
+          }
+          break;
+        } else if (argv[i][j] == 'j') {
+          // -j N or -jN; takes the rest of the argument.
+          const char* count = &argv[i][j + 1];
+          if (*count == '\0' && i + 1 < argc) {
+            count = argv[++i];
+          }
+          char* end = nullptr;
+          unsigned long value = std::strtoul(count, &end, 10);
+          if (*count < '0' || *count > '9' || *end != '\0' || value == 0) {
+            std::cout << BOLD RED FATAL RESET "bad job count '" << count << "'" << std::endl;
+            put_usage();
+            return 1;
+          }
+          jobs = value;
+          break;
+        } else if (argv[i][j] == 'h') {
+          put_usage();
+          return 0;
+        } else {
+          std::cout << BOLD RED FATAL RESET "unknown option '-" << argv[i][j] << "'" << std::endl;
+          put_usage();
+          return 1;
         }
       }
     } else {
@@ -2703,6 +3751,35 @@ int main(int argc, char** argv) {
   if (width_limited) {
     c->set_width_limited();
   }
+  if (arena) {
+    c->set_arena();
+  }
+  if (mmap_file) {
+    c->set_mmap_file();
+  }
+  if (events) {
+    c->set_events();
+  }
+  if (validator) {
+    c->set_validator();
+  }
+  if (flat_tree) {
+    c->set_flat_tree();
+  }
+  if (leaves) {
+    c->set_leaves();
+  }
+  if (scanners) {
+    c->set_scanners();
+  }
+  if (trivia) {
+    c->set_trivia();
+  }
+  if (literals) {
+    c->set_literals();
+  }
+  c->set_jobs(jobs);
+  c->set_backend(backend, table_layout);
 
   if (c->is_ll1()) {
     std::ofstream header{};
@@ -17,7 +17,10 @@
 #ifndef RYX_H_
 #define RYX_H_
 
+#include <bitset>
+#include <cstdint>
 #include <iostream>
+#include <iterator>
 #include <string>
 #include <unordered_map>
 #include <unordered_set>
@@ -27,11 +30,146 @@ using token_id = std::size_t;
 using rule_id = std::size_t;
 using id_to_token_type = std::unordered_map<token_id, std::string>;
 using token_to_id_type = std::unordered_map<std::string, token_id>;
-using rules_type = std::unordered_map<rule_id,
-                                      std::pair<token_id, std::vector<token_id>>>;
-using table_type = std::unordered_map<token_id,
-                                      std::unordered_map<token_id, rule_id>>;
 using token_set_type = std::unordered_set<token_id>;
+// the bytes a character class terminal matches.
+using char_class_type = std::bitset<256>;
+using classes_type = std::unordered_map<token_id, char_class_type>;
+// the bytes a literal terminal matches; two or more.
+using literals_type = std::unordered_map<token_id, std::string>;
+// the counts a repetition helper X[n] -> x X[n] | (empty) takes x, from min to max.
+using repeats_type = std::unordered_map<token_id, std::pair<std::size_t, std::size_t>>;
+
+// the right hand side of a rule, in place in the rule store.
+class rule_body_type {
+ public:
+  using const_iterator = const token_id*;
+  using const_reverse_iterator = std::reverse_iterator<const_iterator>;
+
+  rule_body_type(const_iterator first, const_iterator last) : first_(first), last_(last) {}
+
+  const_iterator begin(void) const { return first_; }
+  const_iterator end(void) const { return last_; }
+  const_reverse_iterator rbegin(void) const { return const_reverse_iterator(last_); }
+  const_reverse_iterator rend(void) const { return const_reverse_iterator(first_); }
+  std::size_t size(void) const { return static_cast<std::size_t>(last_ - first_); }
+  bool empty(void) const { return first_ == last_; }
+  token_id front(void) const { return *first_; }
+  token_id back(void) const { return *(last_ - 1); }
+  token_id operator[](std::size_t i) const { return first_[i]; }
+
+ private:
+  const_iterator first_, last_;
+};
+
+// the rules in compressed sparse rows; rule r is
+// heads[r] -> symbols[begins[r]] .. symbols[begins[r + 1] - 1].
+struct rules_type {
+  std::vector<token_id> heads;
+  std::vector<std::size_t> begins{0};
+  std::vector<token_id> symbols;
+
+  std::size_t size(void) const { return heads.size(); }
+  token_id head(rule_id rid) const { return heads[rid]; }
+  rule_body_type body(rule_id rid) const {
+    return rule_body_type(symbols.data() + begins[rid], symbols.data() + begins[rid + 1]);
+  }
+  rule_id add(token_id head_id, const std::vector<token_id>& body_ids) {
+    heads.push_back(head_id);
+    symbols.insert(symbols.end(), body_ids.begin(), body_ids.end());
+    begins.push_back(symbols.size());
+    return heads.size() - 1;
+  }
+  void clear(void) {
+    heads.clear();
+    begins.assign(1, 0);
+    symbols.clear();
+    return;
+  }
+};
+
+// the LL(1) table; the nonterms number its rows and the terminals its columns densely,
+// in the order of their ids. a cell holds the rule to expand, or a number from
+// rules.size() up when there is none.
+struct table_type {
+  static const std::size_t npos = static_cast<std::size_t>(-1);
+  // the empty and the booked cells take the two numbers after the last rule.
+  static const std::size_t max_rules = 0xFFFE;
+
+  std::vector<token_id> nonterms, terms;
+  // the row of a nonterm, and the column of a terminal, by id; npos off the table.
+  std::vector<std::size_t> row_of, column_of;
+  std::vector<std::uint16_t> cells;
+
+  std::size_t row(token_id nonterm) const {
+    return nonterm < row_of.size() ? row_of[nonterm] : npos;
+  }
+  std::size_t column(token_id term) const {
+    return term < column_of.size() ? column_of[term] : npos;
+  }
+  bool has_row(token_id nonterm) const { return row(nonterm) != npos; }
+  std::uint16_t& cell(std::size_t r, std::size_t c) { return cells[r * terms.size() + c]; }
+  rule_id cell(std::size_t r, std::size_t c) const { return cells[r * terms.size() + c]; }
+  rule_id at(token_id nonterm, token_id term) const {
+    std::size_t r = row(nonterm), c = column(term);
+    return r == npos || c == npos ? 0xFFFF : cell(r, c);
+  }
+};
+
+// sets of the columns of the table, one row of 64-bit words each; a union goes a word at
+// a time.
+struct column_sets_type {
+  std::size_t words = 0;
+  std::vector<std::uint64_t> bits;
+
+  void assign(std::size_t sets, std::size_t columns) {
+    words = (columns + 63) / 64;
+    bits.assign(sets * words, 0);
+    return;
+  }
+  std::uint64_t* operator[](std::size_t set) { return bits.data() + set * words; }
+  const std::uint64_t* operator[](std::size_t set) const { return bits.data() + set * words; }
+  bool test(std::size_t set, std::size_t column) const {
+    return (((*this)[set][column / 64] >> (column % 64)) & 1) != 0;
+  }
+  void clear(std::size_t set) {
+    std::uint64_t* row = (*this)[set];
+    for (std::size_t i = 0; i < words; ++i) {
+      row[i] = 0;
+    }
+    return;
+  }
+  // whether the column was not in the set yet.
+  bool insert(std::size_t set, std::size_t column) {
+    std::uint64_t& word = (*this)[set][column / 64];
+    std::uint64_t bit = std::uint64_t{1} << (column % 64);
+    bool inserted = (word & bit) == 0;
+    word |= bit;
+    return inserted;
+  }
+  // whether the set grew.
+  bool unite(std::size_t set, const std::uint64_t* other) {
+    std::uint64_t* row = (*this)[set];
+    std::uint64_t grown = 0;
+    for (std::size_t i = 0; i < words; ++i) {
+      grown |= other[i] & ~row[i];
+      row[i] |= other[i];
+    }
+    return grown != 0;
+  }
+  std::vector<std::size_t> columns(std::size_t set) const {
+    std::vector<std::size_t> ret{};
+    const std::uint64_t* row = (*this)[set];
+    for (std::size_t i = 0; i < words; ++i) {
+      std::size_t column = i * 64;
+      for (std::uint64_t word = row[i]; word != 0; word >>= 1, ++column) {
+        if ((word & 1) != 0) {
+          ret.push_back(column);
+        }
+      }
+    }
+    return ret;
+  }
+};
 
 char itoh(int x);
 
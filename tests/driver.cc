@@ -0,0 +1,449 @@
+// driver.cc -- runs a generated parser over the inputs of a test
+// Copyright (C) 2018 pixie-grasper
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+// usage: driver HEADER INPUTS [tree|valid]
+//
+// parses each line of INPUTS, with \n, \t, \r, \\ and \xHH as escapes, from a buffer,
+// by pulling the shared byte tokens and tokens from the heap, in chunks of 1 and 3 bytes,
+// and from a file with -m; prints the line and the tree, or `reject`, once all of them
+// agree. the parser has to free each token from the heap once, or the line says how many
+// it leaks or frees twice. with `valid`, prints what ryx_validate_with_stack says instead,
+// and what ryx_validate says where that differs.
+//
+// built with the flags of the generated parser:
+//   RYX_TEST_EVENTS    -e; the tree is made of the events.
+//   RYX_TEST_LEAVES    -l or -d; the tree has the end offsets of the nodes.
+//   RYX_TEST_FILE      -m; ryx_parse_file is one more way.
+//   RYX_TEST_VALIDATE  -r; ryx_validate and ryx_validate_with_stack are there.
+//
+// the tree comes out the same whatever the flags: the whitespace nodes are left out, and
+// the terminals next to each other, or under a leaf of -l, print as one run of their bytes.
+
+// the parser is part of this unit, so that pulling takes its shared byte tokens.
+#include "ryx_parse.cc"
+
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace {
+
+struct kind_info {
+  std::string ident;
+  std::string name;
+};
+
+std::map<int, kind_info> kinds{};
+
+// takes the kinds from the enum of the header: `  ryx_node_kind_XXX = N, // NAME`.
+bool read_kinds(const char* path) {
+  std::ifstream header{path};
+  if (!header.is_open()) {
+    return false;
+  }
+  std::string line{};
+  while (std::getline(header, line)) {
+    std::size_t ident = line.find("ryx_node_kind_");
+    std::size_t equal = line.find(" = ");
+    std::size_t comment = line.find(", // ");
+    if (ident != 2 || equal == std::string::npos || comment == std::string::npos) {
+      continue;
+    }
+    kind_info info{line.substr(ident, equal - ident), line.substr(comment + 5)};
+    kinds[std::stoi(line.substr(equal + 3, comment - equal - 3))] = info;
+  }
+  return !kinds.empty();
+}
+
+bool is_whitespace(int kind) {
+  const std::string& name = kinds[kind].name;
+  return name == ":ws*:" || name == ":ws:";
+}
+
+// a literal of -k spans its bytes; every other terminal, one byte.
+std::size_t terminal_length(int kind) {
+  const kind_info& info = kinds[kind];
+  if (info.ident.compare(0, 22, "ryx_node_kind_literal_") == 0) {
+    return info.name.size() - 2;
+  }
+  return 1;
+}
+
+std::string escape(const std::string& bytes) {
+  std::string ret{};
+  for (auto&& it = bytes.begin(); it != bytes.end(); ++it) {
+    unsigned char c = static_cast<unsigned char>(*it);
+    if (c == '\n') {
+      ret += "\\n";
+    } else if (c == '\t') {
+      ret += "\\t";
+    } else if (c == '\r') {
+      ret += "\\r";
+    } else if (c == '\\' || c == '"') {
+      ret += "\\";
+      ret.push_back(static_cast<char>(c));
+    } else if (c < 0x20 || c >= 0x7F) {
+      char hex[8];
+      std::snprintf(hex, sizeof(hex), "\\x%02X", c);
+      ret += hex;
+    } else {
+      ret.push_back(static_cast<char>(c));
+    }
+  }
+  return ret;
+}
+
+bool unescape(const std::string& line, std::string* bytes) {
+  bytes->clear();
+  for (std::size_t i = 0; i < line.size(); ++i) {
+    if (line[i] != '\\') {
+      bytes->push_back(line[i]);
+      continue;
+    } else if (i + 1 == line.size()) {
+      return false;
+    }
+    char c = line[++i];
+    if (c == 'n') {
+      bytes->push_back('\n');
+    } else if (c == 't') {
+      bytes->push_back('\t');
+    } else if (c == 'r') {
+      bytes->push_back('\r');
+    } else if (c == '\\') {
+      bytes->push_back('\\');
+    } else if (c == 'x' && i + 2 < line.size()) {
+      bytes->push_back(static_cast<char>(std::stoi(line.substr(i + 1, 2), nullptr, 16)));
+      i += 2;
+    } else {
+      return false;
+    }
+  }
+  return true;
+}
+
+// prints a tree as (NAME@OFFSET ...), from the nodes of a tree or from the events.
+class printer {
+ public:
+  explicit printer(const std::string& text_)
+      : text(text_), out{}, run_begin(0), run_end(0), skipped(0) {
+    return;
+  }
+
+  void open(int kind, std::size_t offset) {
+    if (skipped != 0 || is_whitespace(kind)) {
+      skipped += 1;
+      return;
+    }
+    flush();
+    out += (out.empty() ? "(" : " (") + kinds[kind].name + "@" + std::to_string(offset);
+    return;
+  }
+
+  void close(void) {
+    if (skipped != 0) {
+      skipped -= 1;
+      return;
+    }
+    flush();
+    out += ")";
+    return;
+  }
+
+  void terminal(int kind, std::size_t offset) {
+    bytes(offset, offset + terminal_length(kind));
+    return;
+  }
+
+  // the bytes [begin, end) of the input under the node on the top.
+  void bytes(std::size_t begin, std::size_t end) {
+    if (skipped != 0 || begin == end) {
+      return;
+    }
+    if (run_begin == run_end || run_end != begin) {
+      flush();
+      run_begin = begin;
+    }
+    run_end = end;
+    return;
+  }
+
+  std::string str(void) {
+    flush();
+    return out;
+  }
+
+ private:
+  const std::string& text;
+  std::string out;
+  std::size_t run_begin, run_end;
+  std::size_t skipped;
+
+  void flush(void) {
+    if (run_begin != run_end) {
+      out += " \"" + escape(text.substr(run_begin, run_end - run_begin)) + "\"@"
+           + std::to_string(run_begin);
+    }
+    run_begin = run_end = 0;
+    return;
+  }
+};
+
+// what the parser is given as its user data, whichever way it reads.
+struct session {
+  const std::string* text;
+  std::size_t cursor;
+  printer* out;
+  bool heap;
+};
+
+// the tokens from the heap that the parser is given and has not freed yet.
+std::set<struct ryx_token*> live_tokens{};
+std::size_t freed_twice = 0;
+
+void free_heap_token(struct ryx_token* token) {
+  if (live_tokens.erase(token) == 0) {
+    freed_twice += 1;
+    return;
+  }
+  delete token;
+  return;
+}
+
+#ifndef RYX_TEST_EVENTS
+bool is_nonterm(int kind) {
+  return kind >= ryx_node_kind_nonterm_0;
+}
+
+void dump(printer* out, struct ryx_tree* node) {
+  for (; node != NULLPTR; node = ryx_get_next_node(node)) {
+    int kind = ryx_get_token(node)->kind;
+    if (!is_nonterm(kind)) {
+      out->terminal(kind, ryx_get_offset(node));
+      continue;
+    }
+    out->open(kind, ryx_get_offset(node));
+    struct ryx_tree* sub = ryx_get_sub_node(node);
+#ifdef RYX_TEST_LEAVES
+    if (sub == NULLPTR) {
+      out->bytes(ryx_get_offset(node), ryx_get_end_offset(node));
+    }
+#endif
+    dump(out, sub);
+    out->close();
+  }
+  return;
+}
+
+std::string result_of(printer* out, struct ryx_tree* tree) {
+  if (tree == NULLPTR) {
+    return "reject";
+  }
+  dump(out, tree);
+  ryx_tree_free(tree);
+  return out->str();
+}
+#else
+std::string result_of(printer* out, int accepted) {
+  if (!accepted) {
+    return "reject";
+  }
+  return out->str();
+}
+#endif
+
+std::string parse_buffer(const std::string& text) {
+  printer out{text};
+#ifdef RYX_TEST_EVENTS
+  session s{&text, 0, &out, false};
+  return result_of(&out, ryx_parse_buffer(text.data(), text.size(), &s));
+#else
+  return result_of(&out, ryx_parse_buffer(text.data(), text.size()));
+#endif
+}
+
+std::string parse_pull(const std::string& text, bool heap) {
+  printer out{text};
+  session s{&text, 0, &out, heap};
+  std::string ret = result_of(&out, ryx_parse(&s));
+  if (!live_tokens.empty()) {
+    ret += " (leaks " + std::to_string(live_tokens.size()) + " tokens)";
+  }
+  if (freed_twice != 0) {
+    ret += " (frees " + std::to_string(freed_twice) + " tokens twice)";
+  }
+  for (auto&& it = live_tokens.begin(); it != live_tokens.end(); ++it) {
+    delete *it;
+  }
+  live_tokens.clear();
+  freed_twice = 0;
+  return ret;
+}
+
+std::string parse_chunks(const std::string& text, std::size_t step) {
+  printer out{text};
+#ifdef RYX_TEST_EVENTS
+  session s{&text, 0, &out, false};
+  struct ryx_parser* parser = ryx_parser_new(&s);
+#else
+  struct ryx_parser* parser = ryx_parser_new();
+#endif
+  for (std::size_t i = 0; i < text.size(); i += step) {
+    std::size_t len = std::min(step, text.size() - i);
+    if (!ryx_parser_feed(parser, text.data() + i, len)) {
+      break;
+    }
+  }
+  return result_of(&out, ryx_parser_finish(parser));
+}
+
+#ifdef RYX_TEST_FILE
+std::string parse_file(const std::string& text, const std::string& path) {
+  std::ofstream file{path, std::ofstream::binary};
+  file << text;
+  file.close();
+  printer out{text};
+  return result_of(&out, ryx_parse_file(path.c_str()));
+}
+#endif
+
+#ifdef RYX_TEST_VALIDATE
+std::string validation_of(int ret, std::size_t error_offset) {
+  if (ret == 1) {
+    return "accept";
+  } else if (ret == 0) {
+    return "reject@" + std::to_string(error_offset);
+  } else {
+    return "overflow@" + std::to_string(error_offset);
+  }
+}
+
+// checks with the smallest stack of the caller that holds the parse; ryx_validate has to
+// say the same, or overflow when that is more than its own stack.
+std::string validate(const std::string& text) {
+  std::vector<enum ryx_node_kind> stack{};
+  std::size_t error_offset = 0;
+  int ret = 0;
+  while ((ret = ryx_validate_with_stack(text.data(), text.size(), stack.data(), stack.size(),
+                                        &error_offset)) < 0) {
+    stack.resize(stack.size() + 1);
+  }
+  std::string result = validation_of(ret, error_offset);
+  std::size_t own_error_offset = 0;
+  int own = ryx_validate(text.data(), text.size(), &own_error_offset);
+  std::string own_result = validation_of(own, own_error_offset);
+  if (stack.size() > RYX_VALIDATE_STACK_SIZE ? own >= 0 : own_result != result) {
+    return result + " (but ryx_validate => " + own_result + ")";
+  }
+  return result;
+}
+#endif
+
+}  // namespace
+
+EXTERN struct ryx_token* ryx_get_next_token(ryx_user_data input) {
+  session* s = static_cast<session*>(input);
+  struct ryx_token* shared = &ryx_end_token;
+  if (s->cursor < s->text->size()) {
+    shared = &ryx_byte_tokens[static_cast<unsigned char>((*s->text)[s->cursor++])];
+  }
+  if (!s->heap) {
+    return shared;
+  }
+  struct ryx_token* token = new ryx_token{shared->kind, NULLPTR, free_heap_token};
+  live_tokens.insert(token);
+  return token;
+}
+
+#ifdef RYX_TEST_EVENTS
+EXTERN void ryx_on_enter(ryx_user_data data, enum ryx_node_kind kind, size_t offset) {
+  static_cast<session*>(data)->out->open(kind, offset);
+  return;
+}
+
+EXTERN void ryx_on_exit(ryx_user_data data, enum ryx_node_kind) {
+  static_cast<session*>(data)->out->close();
+  return;
+}
+
+EXTERN void ryx_on_terminal(ryx_user_data data, struct ryx_token* token, size_t offset) {
+  static_cast<session*>(data)->out->terminal(token->kind, offset);
+  return;
+}
+
+// a lexeme of -l comes as one event in place of its node.
+EXTERN void ryx_on_lexeme(ryx_user_data data, enum ryx_node_kind kind, size_t begin, size_t end) {
+  printer* out = static_cast<session*>(data)->out;
+  out->open(kind, begin);
+  out->bytes(begin, end);
+  out->close();
+  return;
+}
+
+// the whitespace is left out of the tree anyway.
+EXTERN void ryx_on_trivia(ryx_user_data, size_t, size_t) {
+  return;
+}
+#endif
+
+int main(int argc, char** argv) {
+  if (argc < 3 || !read_kinds(argv[1])) {
+    std::cerr << "usage: driver HEADER INPUTS [tree|valid]" << std::endl;
+    return 2;
+  }
+  std::ifstream inputs{argv[2]};
+  std::string mode = argc > 3 ? argv[3] : "tree";
+  // -m maps the input from a file in the current directory.
+  std::string file_path = "driver_input.tmp";
+
+  std::string line{}, text{};
+  int status = 0;
+  while (std::getline(inputs, line)) {
+    if (!unescape(line, &text)) {
+      std::cout << line << " => bad escape" << std::endl;
+      status = 1;
+      continue;
+    }
+#ifdef RYX_TEST_VALIDATE
+    if (mode == "valid") {
+      std::cout << line << " => " << validate(text) << std::endl;
+      continue;
+    }
+#endif
+    std::vector<std::pair<std::string, std::string>> results{};
+    results.push_back(std::make_pair("buffer", parse_buffer(text)));
+    results.push_back(std::make_pair("pull", parse_pull(text, false)));
+    results.push_back(std::make_pair("heap", parse_pull(text, true)));
+    results.push_back(std::make_pair("chunks of 1", parse_chunks(text, 1)));
+    results.push_back(std::make_pair("chunks of 3", parse_chunks(text, 3)));
+#ifdef RYX_TEST_FILE
+    results.push_back(std::make_pair("file", parse_file(text, file_path)));
+#endif
+    std::cout << line << " => " << results.front().second << std::endl;
+    for (auto&& it = results.begin() + 1; it != results.end(); ++it) {
+      if (it->second != results.front().second) {
+        std::cout << "  but " << it->first << " => " << it->second << std::endl;
+      }
+    }
+  }
+#ifdef RYX_TEST_FILE
+  std::remove(file_path.c_str());
+#endif
+  return status;
+}
@@ -0,0 +1,151 @@
+#!/bin/sh
+# run.sh -- regenerates the parsers of the tests and checks them over their inputs
+# Copyright (C) 2018 pixie-grasper
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+# usage: tests/run.sh [RYX [CXX]]
+#
+# for each NAME.grammar here, generates the parser in every configuration below, runs
+# driver.cc over NAME.input, and compares the trees with NAME.tree and what ryx_validate
+# says with NAME.valid; then checks that -j1 and -j4 generate the same files.
+
+tests=$(cd "$(dirname "$0")" && pwd)
+ryx=${1:-$tests/../ryx}
+cxx=${2:-${CXX:-c++}}
+case $ryx in
+  /*) ;;
+  *) ryx=$(pwd)/$ryx ;;
+esac
+
+work=$(mktemp -d "${TMPDIR:-/tmp}/ryx-tests.XXXXXX") || exit 1
+trap 'rm -rf "$work"' EXIT
+
+# the loops below run in subshells, so the results go through files.
+: > "$work/passed"
+: > "$work/failed"
+
+pass() {
+  echo "$*" >> "$work/passed"
+}
+
+fail() {
+  echo "FAIL: $*"
+  echo "$*" >> "$work/failed"
+}
+
+# NAME|FLAGS OF RYX|DEFINES OF THE DRIVER
+# the small-stack ones start from a stack of one symbol, which grows on every push; the
+# validate-small ones give ryx_validate a stack of four, which the longer inputs overflow.
+configs='switch|-q|
+arena|-q -a|
+table|-q -btable|
+table-dense|-q -btable-dense|
+table-comb|-q -btable-comb|
+arena-table|-q -a -btable|
+mmap|-q -m|-DRYX_TEST_FILE
+events|-q -e|-DRYX_TEST_EVENTS
+events-table|-q -e -btable-comb|-DRYX_TEST_EVENTS
+flat|-q -f|
+flat-table|-q -f -btable|
+flat-full|-q -f|-DRYX_FLAT_MAX_NODES=0
+leaves|-q -l|-DRYX_TEST_LEAVES
+leaves-events|-q -l -e|-DRYX_TEST_EVENTS
+leaves-flat|-q -l -f -btable|-DRYX_TEST_LEAVES
+scanners|-q -d|-DRYX_TEST_LEAVES
+scanners-events|-q -d -e -btable|-DRYX_TEST_EVENTS
+scanners-flat|-q -d -f|-DRYX_TEST_LEAVES
+trivia-flat|-q -s -f|
+trivia-events|-q -s -e -btable|-DRYX_TEST_EVENTS
+literals|-q -k|
+literals-table|-q -k -btable|
+literals-events|-q -k -s -d -e|-DRYX_TEST_EVENTS
+validate|-q -r|-DRYX_TEST_VALIDATE
+validate-table|-q -r -btable|-DRYX_TEST_VALIDATE
+validate-comb|-q -r -k -s -btable-comb|-DRYX_TEST_VALIDATE
+validate-small|-q -r|-DRYX_TEST_VALIDATE -DRYX_VALIDATE_STACK_SIZE=4
+validate-small-table|-q -r -btable|-DRYX_TEST_VALIDATE -DRYX_VALIDATE_STACK_SIZE=4
+small-stack|-q|-DRYX_STACK_INITIAL_CAPACITY=1
+small-stack-arena|-q -a|-DRYX_STACK_INITIAL_CAPACITY=1
+small-stack-table|-q -btable-comb|-DRYX_STACK_INITIAL_CAPACITY=1'
+
+for grammar in "$tests"/*.grammar; do
+  name=$(basename "$grammar" .grammar)
+
+  echo "$configs" | while IFS='|' read -r config flags defines; do
+    dir=$work/$name-$config
+    mkdir -p "$dir"
+    # the flags and the defines split into words on purpose.
+    if ! (cd "$dir" && "$ryx" $flags "$grammar" > ryx.log 2>&1); then
+      cat "$dir/ryx.log"
+      fail "$name: ryx $flags"
+      continue
+    fi
+    if ! $cxx -std=c++14 -I"$dir" $defines "$tests/driver.cc" -o "$dir/driver" > "$dir/cxx.log" 2>&1; then
+      cat "$dir/cxx.log"
+      fail "$name: $cxx $defines for ryx $flags"
+      continue
+    fi
+    case $defines in
+      *RYX_FLAT_MAX_NODES=0*)
+        # no node fits, so every line is rejected.
+        sed 's/ => .*/ => reject/' "$tests/$name.tree" > "$dir/tree.expected"
+        ;;
+      *)
+        cp "$tests/$name.tree" "$dir/tree.expected"
+        ;;
+    esac
+    (cd "$dir" && ./driver ryx_parse.h "$tests/$name.input" tree > tree.out 2>&1)
+    if diff -u "$dir/tree.expected" "$dir/tree.out"; then
+      pass "$name: trees of ryx $flags"
+    else
+      fail "$name: trees of ryx $flags"
+    fi
+    case $defines in
+      *RYX_TEST_VALIDATE*)
+        (cd "$dir" && ./driver ryx_parse.h "$tests/$name.input" valid > valid.out 2>&1)
+        if diff -u "$tests/$name.valid" "$dir/valid.out"; then
+          pass "$name: ryx_validate of ryx $flags"
+        else
+          fail "$name: ryx_validate of ryx $flags"
+        fi
+        ;;
+    esac
+  done
+
+  for flags in "-v" "-v -btable-comb -l -d -s -k"; do
+    mkdir -p "$work/$name-j1" "$work/$name-j4"
+    (cd "$work/$name-j1" && "$ryx" $flags -j1 "$grammar" > ryx.log 2>&1)
+    (cd "$work/$name-j4" && "$ryx" $flags -j 4 "$grammar" > ryx.log 2>&1)
+    if diff -r "$work/$name-j1" "$work/$name-j4" > /dev/null; then
+      pass "$name: ryx $flags -j1 and -j 4"
+    else
+      fail "$name: ryx $flags -j1 and -j 4 differ"
+    fi
+  done
+done
+
+# a count of no threads, or of none at all, is a usage error.
+for count in 0 x 4x; do
+  if "$ryx" -j "$count" < /dev/null > "$work/jobs.log" 2>&1 || ! grep -q '^usage:' "$work/jobs.log"; then
+    fail "ryx -j $count is not a usage error"
+  else
+    pass "ryx -j $count is a usage error"
+  fi
+done
+
+passed=$(wc -l < "$work/passed")
+failed=$(wc -l < "$work/failed")
+echo "passed $passed, failed $failed"
+test "$failed" -eq 0